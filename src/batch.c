@@ -0,0 +1,246 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cjson/cJSON.h>
+
+#include "batch.h"
+#include "generate.h"
+#include "input.h"
+#include "parse.h"
+#include "util.h"
+
+/*
+	the manifest is a json array of libraries, each of which looks like:
+
+	{
+		"name": "c172p",
+		"desc": "Cessna 172P",
+		"output": "docs/c172p",
+		"inputs": [ "Aircraft/c172p/Nasal/", "extra.nas:c172p.extra" ]
+	}
+
+	inputs are given as on the command line, except that directories are
+	searched for nasal files; with no inputs, the current directory is searched
+*/
+
+struct library {
+	const char* name;
+	const char* desc;
+	const char* output;
+	char** args;
+	int n_args;
+	int ret;
+};
+
+struct batch_job {
+	struct generator* gen;
+	struct library* libraries;
+	int count, next;
+	pthread_mutex_t lock;
+};
+
+static int document_library(struct generator* gen, struct library* library) {
+	struct input* inputs = calloc(MAX_INPUTS, sizeof(struct input));
+	int n_inputs = 0;
+	int ret = 0;
+
+	char* files[library->n_args + 1];
+	int n_files = 0;
+
+	for (int i = 0; i < library->n_args; i++) {
+		struct stat st;
+
+		if (stat(library->args[i], &st) == 0 && S_ISDIR(st.st_mode)) {
+			if (search_inputs(library->args[i], inputs, &n_inputs) == -1) ret = 1;
+		} else {
+			files[n_files++] = library->args[i];
+		}
+	}
+
+	if (ret == 0 && (n_files > 0 || n_inputs == 0)) {
+		int n_parsed;
+		if (n_inputs + n_files > MAX_INPUTS) {
+			errorf("%s: too many input files\n", library->name);
+			ret = 1;
+		} else if (
+			parse_inputs(files, n_files, inputs + n_inputs, &n_parsed) == -1
+		) {
+			ret = 1;
+		} else {
+			n_inputs += n_parsed;
+		}
+	}
+
+	if (ret == 0 && resolve_inputs(inputs, n_inputs) == -1) ret = 2;
+
+	struct module* fragments[n_inputs + 1];
+	int n_fragments = 0;
+
+	for (; ret == 0 && n_fragments < n_inputs; n_fragments++) {
+		ret = parse_input(&inputs[n_fragments], &fragments[n_fragments]);
+		if (ret > 0) break;
+	}
+
+	if (ret == 0) {
+		struct list* containers = list_new();
+		struct module* root =
+			assemble_tree(inputs, fragments, n_inputs, library->desc, containers);
+
+		struct source sources[n_inputs + 1];
+		inputs_to_sources(inputs, n_inputs, sources);
+
+		ret = generator_run_library(
+			gen, root, sources, library->name, library->output
+		);
+
+		list_free(containers, (void (*)(void*)) container_free);
+	}
+
+	for (int i = 0; i < n_fragments; i++) module_free(fragments[i]);
+	for (int i = 0; i < n_inputs; i++) input_free(&inputs[i]);
+	free(inputs);
+
+	return ret;
+}
+
+static void* batch_worker(void* arg) {
+	struct batch_job* job = arg;
+
+	while (true) {
+		pthread_mutex_lock(&job->lock);
+		int i = job->next++;
+		pthread_mutex_unlock(&job->lock);
+
+		if (i >= job->count) break;
+
+		struct library* library = &job->libraries[i];
+		if ((library->ret = document_library(job->gen, library)) > 0)
+			errorf("failed to document library '%s'\n", library->name);
+	}
+
+	return NULL;
+}
+
+static const char* json_string(
+	cJSON* object,
+	const char* key,
+	const char* def
+) {
+	cJSON* value = cJSON_GetObjectItem(object, key);
+	return cJSON_IsString(value) ? value->valuestring : def;
+}
+
+static int read_manifest(
+	const char* filename,
+	cJSON** json,
+	struct library** libraries
+) {
+	char* contents = read_file(filename);
+	if (contents == NULL) return -2;
+
+	*json = cJSON_Parse(contents);
+	free(contents);
+
+	if (!cJSON_IsArray(*json)) {
+		errorf("'%s' is not a json array of libraries\n", filename);
+		cJSON_Delete(*json);
+		return -1;
+	}
+
+	int count = cJSON_GetArraySize(*json);
+	*libraries = calloc(count + 1, sizeof(struct library));
+
+	for (int i = 0; i < count; i++) {
+		cJSON* entry = cJSON_GetArrayItem(*json, i);
+		struct library* library = &(*libraries)[i];
+
+		library->name = json_string(entry, "name", "globals");
+		library->desc = json_string(entry, "desc", "");
+		library->output = json_string(entry, "output", NULL);
+
+		if (!cJSON_IsObject(entry) || library->output == NULL) {
+			errorf("library %d in '%s' has no output directory\n", i, filename);
+			count = -1;
+			break;
+		}
+
+		cJSON* inputs = cJSON_GetObjectItem(entry, "inputs");
+		library->args = calloc(cJSON_GetArraySize(inputs) + 1, sizeof(char*));
+
+		cJSON* input;
+		cJSON_ArrayForEach(input, inputs) {
+			if (!cJSON_IsString(input)) {
+				errorf("inputs of library %d in '%s' must be strings\n", i, filename);
+				count = -1;
+				break;
+			}
+
+			library->args[library->n_args++] = input->valuestring;
+		}
+
+		if (count == -1) break;
+	}
+
+	if (count == -1) {
+		for (int i = 0; (*libraries)[i].name; i++) free((*libraries)[i].args);
+		free(*libraries);
+		cJSON_Delete(*json);
+	}
+
+	return count;
+}
+
+// documents several libraries in one process, sharing the loaded templates,
+// static files and rendered markdown between them
+int run_batch(const char* manifest, struct generate_options opts) {
+	cJSON* json = NULL;
+	struct library* libraries = NULL;
+
+	int count = read_manifest(manifest, &json, &libraries);
+	if (count < 0) return count == -2 ? 2 : 1;
+
+	opts.memoise = !opts.no_markdown;
+
+	int ret;
+	struct generator* gen = generator_new(opts, &ret);
+
+	if (gen != NULL) {
+		struct batch_job job = {
+			.gen = gen,
+			.libraries = libraries,
+			.count = count,
+			.next = 0,
+		};
+
+		pthread_mutex_init(&job.lock, NULL);
+
+		parse_init();
+
+		long n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+		if (n_threads < 1) n_threads = 1;
+		if (n_threads > count) n_threads = count;
+
+		pthread_t threads[n_threads + 1];
+		for (long i = 0; i < n_threads; i++)
+			pthread_create(&threads[i], NULL, batch_worker, &job);
+		for (long i = 0; i < n_threads; i++)
+			pthread_join(threads[i], NULL);
+
+		pthread_mutex_destroy(&job.lock);
+		generator_free(gen);
+
+		for (int i = 0; i < count; i++)
+			if (libraries[i].ret > ret) ret = libraries[i].ret;
+	}
+
+	for (int i = 0; i < count; i++) free(libraries[i].args);
+	free(libraries);
+	cJSON_Delete(json);
+
+	return ret;
+}
@@ -0,0 +1,8 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "generate.h"
+
+int run_batch(const char* manifest, struct generate_options opts);
+
+#endif // ifndef BATCH_H
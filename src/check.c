@@ -0,0 +1,221 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <cjson/cJSON.h>
+
+#include "check.h"
+#include "generate.h"
+#include "parse.h"
+#include "symbols.h"
+#include "util.h"
+
+struct check_job {
+	struct source* sources;
+	struct list** problems;
+	struct list** references; /* NULL unless resolving */
+	struct module** fragments;
+	int count, next;
+	pthread_mutex_t lock;
+};
+
+static void* check_worker(void* arg) {
+	struct check_job* job = arg;
+
+	while (true) {
+		pthread_mutex_lock(&job->lock);
+		int i = job->next++;
+		pthread_mutex_unlock(&job->lock);
+
+		if (i >= job->count) break;
+
+		check_file(
+			job->sources[i].file,
+			job->sources[i].alias,
+			job->problems[i],
+			job->references ? job->references[i] : NULL,
+			job->references ? &job->fragments[i] : NULL
+		);
+	}
+
+	return NULL;
+}
+
+static void print_diagnostic(struct diagnostic* diagnostic) {
+	cJSON* json = cJSON_CreateObject();
+
+	cJSON_AddStringToObject(json, "file", diagnostic->file);
+	cJSON_AddNumberToObject(json, "line", diagnostic->line);
+	cJSON_AddStringToObject(
+		json, "severity", diagnostic->error ? "error" : "warning"
+	);
+	cJSON_AddStringToObject(json, "code", diagnostic->code);
+	cJSON_AddStringToObject(json, "message", diagnostic->message);
+
+	char* printed = cJSON_PrintUnformatted(json);
+	puts(printed);
+
+	free(printed);
+	cJSON_Delete(json);
+}
+
+static void add_symbols(
+	struct map* symbols,
+	struct list* items,
+	const char* path
+) {
+	LIST_ITER_T(items, item, struct item*) {
+		char* item_path = path[0]
+			? asprintf("%s.%s", path, item->name)
+			: asprintf("%s", item->name);
+
+		map_set(symbols, item_path, item);
+		if (item->type == ITEM_CLASS) add_symbols(symbols, item->items, item_path);
+
+		free(item_path);
+	}
+}
+
+static void add_module_symbols(
+	struct map* symbols,
+	struct module* module,
+	const char* path
+) {
+	add_symbols(symbols, module->items, path);
+
+	LIST_ITER_T(module->children, child, struct module*) {
+		char* child_path = path[0]
+			? asprintf("%s.%s", path, child->name)
+			: asprintf("%s", child->name);
+
+		map_set(symbols, child_path, child);
+		add_module_symbols(symbols, child, child_path);
+
+		free(child_path);
+	}
+}
+
+// a name is looked for relative to the module it is written in, then from the
+// root of this library, and then in each linked table
+static bool resolve(
+	struct map* symbols,
+	struct symbols* tables[],
+	const char* module,
+	const char* name
+) {
+	if (module && module[0]) {
+		char* relative = asprintf("%s.%s", module, name);
+		bool found = map_get(symbols, relative) != NULL;
+		free(relative);
+
+		if (found) return true;
+	}
+
+	if (map_get(symbols, name)) return true;
+
+	for (struct symbols** table = tables; *table; table++)
+		if (symbols_lookup(*table, name)) return true;
+
+	return false;
+}
+
+// parses every source and checks its doc comments, without generating anything;
+// problems are written to stdout as one json object per line. with tables, the
+// classes named in markers are also resolved against this library and them
+int check_sources(struct source sources[], struct symbols* tables[]) {
+	int count = 0;
+	while (sources[count].file) count++;
+
+	struct list* problems[count + 1];
+	struct list* references[count + 1];
+	struct module* fragments[count + 1];
+
+	for (int i = 0; i < count; i++) {
+		problems[i] = list_new();
+		references[i] = list_new();
+		fragments[i] = NULL;
+	}
+
+	struct check_job job = {
+		.sources = sources,
+		.problems = problems,
+		.references = tables ? references : NULL,
+		.fragments = fragments,
+		.count = count,
+		.next = 0,
+	};
+
+	pthread_mutex_init(&job.lock, NULL);
+
+	parse_init();
+
+	long n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n_threads < 1) n_threads = 1;
+	if (n_threads > count) n_threads = count;
+
+	pthread_t threads[n_threads + 1];
+	for (long i = 0; i < n_threads; i++)
+		pthread_create(&threads[i], NULL, check_worker, &job);
+	for (long i = 0; i < n_threads; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_mutex_destroy(&job.lock);
+
+	if (tables) {
+		struct map* symbols = map_new();
+		for (int i = 0; i < count; i++) {
+			if (fragments[i] == NULL) continue;
+
+			const char* module = sources[i].module ? sources[i].module : "";
+			add_module_symbols(symbols, fragments[i], module);
+		}
+
+		for (int i = 0; i < count; i++) {
+			LIST_ITER_T(references[i], reference, struct reference*) {
+				if (resolve(symbols, tables, sources[i].module, reference->name))
+					continue;
+
+				struct diagnostic* diagnostic = malloc(sizeof(struct diagnostic));
+				*diagnostic = (struct diagnostic) {
+					reference->file, reference->line, false, "unresolved-class",
+					asprintf(
+						"'%s' does not match any class here or in a linked table",
+						reference->name
+					)
+				};
+
+				list_push(problems[i], diagnostic);
+			}
+		}
+
+		map_free(symbols, NULL);
+	}
+
+	for (int i = 0; i < count; i++) {
+		list_free(references[i], (void (*)(void*)) reference_free);
+		if (fragments[i]) module_free(fragments[i]);
+	}
+
+	int n_errors = 0, n_warnings = 0;
+
+	for (int i = 0; i < count; i++) {
+		LIST_ITER_T(problems[i], diagnostic, struct diagnostic*) {
+			print_diagnostic(diagnostic);
+
+			if (diagnostic->error) n_errors++;
+			else n_warnings++;
+		}
+
+		list_free(problems[i], (void (*)(void*)) diagnostic_free);
+	}
+
+	errorf(
+		"checked %d files: %d errors, %d warnings\n",
+		count, n_errors, n_warnings
+	);
+
+	return n_errors > 0 ? 3 : 0;
+}
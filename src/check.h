@@ -0,0 +1,10 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include "generate.h"
+
+#include "symbols.h"
+
+int check_sources(struct source sources[], struct symbols* tables[]);
+
+#endif // ifndef CHECK_H
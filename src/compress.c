@@ -0,0 +1,255 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <zlib.h>
+
+#ifdef HAVE_BROTLI
+#include <brotli/encode.h>
+#endif
+
+#include "compress.h"
+#include "util.h"
+
+/*
+	a compressor writes a .gz (and with brotli, a .br) beside each file it is
+	given, on a pool of threads so that it happens while the next files are
+	rendered; a .gz is current when its trailer has the crc and size of the
+	data, in which case neither is written again
+*/
+
+#define MAX_QUEUED 256
+
+struct compress_job {
+	char* path;
+	char* data;
+	size_t length;
+};
+
+struct compressor {
+	int dir_fd;
+	struct list* jobs;
+	bool done;
+	int ret;
+
+	pthread_mutex_t lock;
+	pthread_cond_t ready, space;
+
+	long n_threads;
+	pthread_t* threads;
+};
+
+static uint32_t get_u32(const unsigned char* at) {
+	return
+		(uint32_t) at[0] | (uint32_t) at[1] << 8 |
+		(uint32_t) at[2] << 16 | (uint32_t) at[3] << 24;
+}
+
+static bool gzip_current(int dir_fd, const char* path, uint32_t crc, size_t n) {
+	int fd = openat(dir_fd, path, O_RDONLY);
+	if (fd == -1) return false;
+
+	struct stat st;
+	unsigned char trailer[8];
+	bool current =
+		fstat(fd, &st) == 0 && st.st_size >= 18 &&
+		pread(fd, trailer, 8, st.st_size - 8) == 8 &&
+		get_u32(trailer) == crc && get_u32(trailer + 4) == (uint32_t) n;
+
+	close(fd);
+
+	return current;
+}
+
+static int compress_gzip(
+	int dir_fd,
+	const char* path,
+	struct compress_job* job
+) {
+	z_stream stream = { 0 };
+	if (deflateInit2(
+		&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY
+	) != Z_OK) {
+		errorf("failed to compress '%s'\n", job->path);
+		return 3;
+	}
+
+	size_t bound = deflateBound(&stream, job->length);
+	unsigned char* out = malloc(bound);
+
+	stream.next_in = (unsigned char*) job->data;
+	stream.avail_in = job->length;
+	stream.next_out = out;
+	stream.avail_out = bound;
+
+	int ret = 0;
+	if (deflate(&stream, Z_FINISH) != Z_STREAM_END) {
+		errorf("failed to compress '%s'\n", job->path);
+		ret = 3;
+	} else {
+		ret = write_at(dir_fd, path, out, stream.total_out);
+	}
+
+	deflateEnd(&stream);
+	free(out);
+
+	return ret;
+}
+
+#ifdef HAVE_BROTLI
+static int compress_brotli(
+	int dir_fd,
+	const char* path,
+	struct compress_job* job
+) {
+	size_t length = BrotliEncoderMaxCompressedSize(job->length);
+	if (length == 0) length = job->length + 1024;
+
+	uint8_t* out = malloc(length);
+
+	int ret = 0;
+	if (!BrotliEncoderCompress(
+		BROTLI_MAX_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT,
+		job->length, (const uint8_t*) job->data, &length, out
+	)) {
+		errorf("failed to compress '%s'\n", job->path);
+		ret = 3;
+	} else {
+		ret = write_at(dir_fd, path, out, length);
+	}
+
+	free(out);
+
+	return ret;
+}
+#endif
+
+static int compress_job(int dir_fd, struct compress_job* job) {
+	uint32_t crc = crc32(0, (const unsigned char*) job->data, job->length);
+
+	char* gzip = asprintf("%s.gz", job->path);
+	bool current = gzip_current(dir_fd, gzip, crc, job->length);
+
+#ifdef HAVE_BROTLI
+	char* brotli = asprintf("%s.br", job->path);
+	current = current && faccessat(dir_fd, brotli, F_OK, 0) == 0;
+#endif
+
+	int ret = 0;
+	if (!current) {
+		ret = compress_gzip(dir_fd, gzip, job);
+
+#ifdef HAVE_BROTLI
+		if (ret == 0) ret = compress_brotli(dir_fd, brotli, job);
+#endif
+	}
+
+	free(gzip);
+#ifdef HAVE_BROTLI
+	free(brotli);
+#endif
+
+	return ret;
+}
+
+static void* compress_worker(void* user) {
+	struct compressor* compressor = user;
+
+	while (true) {
+		pthread_mutex_lock(&compressor->lock);
+
+		while (list_length(compressor->jobs) == 0 && !compressor->done)
+			pthread_cond_wait(&compressor->ready, &compressor->lock);
+
+		struct compress_job* job = list_pop(compressor->jobs);
+		pthread_cond_signal(&compressor->space);
+		pthread_mutex_unlock(&compressor->lock);
+
+		if (job == NULL) break;
+
+		int ret = compress_job(compressor->dir_fd, job);
+
+		free(job->path);
+		free(job->data);
+		free(job);
+
+		if (ret > 0) {
+			pthread_mutex_lock(&compressor->lock);
+			if (ret > compressor->ret) compressor->ret = ret;
+			pthread_mutex_unlock(&compressor->lock);
+		}
+	}
+
+	return NULL;
+}
+
+struct compressor* compressor_new(int dir_fd) {
+	struct compressor* compressor = calloc(1, sizeof(struct compressor));
+	compressor->dir_fd = dir_fd;
+	compressor->jobs = list_new();
+
+	pthread_mutex_init(&compressor->lock, NULL);
+	pthread_cond_init(&compressor->ready, NULL);
+	pthread_cond_init(&compressor->space, NULL);
+
+	compressor->n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (compressor->n_threads < 1) compressor->n_threads = 1;
+
+	compressor->threads = calloc(compressor->n_threads, sizeof(pthread_t));
+	for (long i = 0; i < compressor->n_threads; i++)
+		pthread_create(&compressor->threads[i], NULL, compress_worker, compressor);
+
+	return compressor;
+}
+
+// queues a copy of the data of the file at path (relative to the dir) to be
+// compressed, waiting if too much is queued already
+void compressor_add(
+	struct compressor* compressor,
+	const char* path,
+	const char* data,
+	size_t length
+) {
+	struct compress_job* job = malloc(sizeof(struct compress_job));
+	job->path = astrndup(path, strlen(path));
+	job->data = malloc(length + 1);
+	job->length = length;
+	memcpy(job->data, data, length);
+
+	pthread_mutex_lock(&compressor->lock);
+
+	while (list_length(compressor->jobs) >= MAX_QUEUED)
+		pthread_cond_wait(&compressor->space, &compressor->lock);
+
+	list_push(compressor->jobs, job);
+	pthread_cond_signal(&compressor->ready);
+	pthread_mutex_unlock(&compressor->lock);
+}
+
+// waits for everything queued to be compressed, then frees the compressor
+int compressor_finish(struct compressor* compressor) {
+	pthread_mutex_lock(&compressor->lock);
+	compressor->done = true;
+	pthread_cond_broadcast(&compressor->ready);
+	pthread_mutex_unlock(&compressor->lock);
+
+	for (long i = 0; i < compressor->n_threads; i++)
+		pthread_join(compressor->threads[i], NULL);
+
+	int ret = compressor->ret;
+
+	list_free(compressor->jobs, NULL);
+	pthread_cond_destroy(&compressor->ready);
+	pthread_cond_destroy(&compressor->space);
+	pthread_mutex_destroy(&compressor->lock);
+	free(compressor->threads);
+	free(compressor);
+
+	return ret;
+}
@@ -0,0 +1,17 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <stddef.h>
+
+struct compressor;
+
+struct compressor* compressor_new(int dir_fd);
+void compressor_add(
+	struct compressor* compressor,
+	const char* path,
+	const char* data,
+	size_t length
+);
+int compressor_finish(struct compressor* compressor);
+
+#endif // ifndef COMPRESS_H
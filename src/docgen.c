@@ -0,0 +1,187 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "docgen.h"
+#include "generate.h"
+#include "input.h"
+#include "parse.h"
+#include "util.h"
+
+struct docgen {
+	struct docgen_options opts;
+	struct generator* gen;
+	struct input* inputs;
+	int n_inputs;
+	struct module** fragments;
+	int n_fragments;
+	struct list* containers; /* module */
+	struct module* root;
+	struct source* sources;
+};
+
+// errors are reported per thread, so they are directed to the context for the
+// duration of each call
+static void enter(struct docgen* ctx) {
+	set_error_handler(ctx->opts.error, ctx->opts.error_user);
+}
+
+static int leave(int ret) {
+	set_error_handler(NULL, NULL);
+	return ret;
+}
+
+struct docgen* docgen_new(const struct docgen_options* opts, int* status) {
+	struct docgen* ctx = calloc(1, sizeof(struct docgen));
+	ctx->opts = *opts;
+	if (!ctx->opts.library) ctx->opts.library = "globals";
+	if (!ctx->opts.desc) ctx->opts.desc = "";
+
+	enter(ctx);
+	parse_init();
+
+	struct generate_options generate = {
+		.library = ctx->opts.library,
+		.template = ctx->opts.template,
+		.no_markdown = ctx->opts.no_markdown,
+		.memoise = !ctx->opts.no_markdown,
+	};
+
+	if (!(ctx->gen = generator_new(generate, status))) {
+		free(ctx);
+		leave(0);
+		return NULL;
+	}
+
+	ctx->inputs = calloc(MAX_INPUTS, sizeof(struct input));
+
+	leave(0);
+	return ctx;
+}
+
+static void forget_tree(struct docgen* ctx) {
+	list_free(ctx->containers, (void (*)(void*)) container_free);
+	for (int i = 0; i < ctx->n_fragments; i++) module_free(ctx->fragments[i]);
+
+	free(ctx->fragments);
+	free(ctx->sources);
+
+	ctx->containers = NULL;
+	ctx->fragments = NULL;
+	ctx->n_fragments = 0;
+	ctx->root = NULL;
+	ctx->sources = NULL;
+}
+
+int docgen_add_input(struct docgen* ctx, const char* file, const char* module) {
+	enter(ctx);
+
+	if (ctx->n_inputs >= MAX_INPUTS) {
+		errorf("too many input files (at most %d)\n", MAX_INPUTS);
+		return leave(1);
+	}
+
+	char* arg = module
+		? asprintf("%s:%s", file, module)
+		: astrndup(file, strlen(file));
+
+	int n_parsed;
+	int ret = parse_inputs(&arg, 1, ctx->inputs + ctx->n_inputs, &n_parsed);
+	free(arg);
+
+	if (ret == -1) return leave(1);
+
+	ctx->n_inputs += n_parsed;
+	return leave(0);
+}
+
+int docgen_add_dir(struct docgen* ctx, const char* dir) {
+	enter(ctx);
+
+	if (search_inputs(dir, ctx->inputs, &ctx->n_inputs) == -1) return leave(1);
+
+	return leave(0);
+}
+
+int docgen_parse(struct docgen* ctx) {
+	enter(ctx);
+	forget_tree(ctx);
+
+	if (ctx->n_inputs == 0) {
+		errorf("no input files\n");
+		return leave(1);
+	}
+
+	// modules are derived from paths relative to the common ancestor of all of
+	// the inputs, so this is done again whenever inputs have been added
+	for (int i = 0; i < ctx->n_inputs; i++) {
+		if (ctx->inputs[i].derived) {
+			free(ctx->inputs[i].module);
+			ctx->inputs[i].module = NULL;
+			ctx->inputs[i].derived = false;
+		}
+	}
+
+	if (resolve_inputs(ctx->inputs, ctx->n_inputs) == -1) return leave(2);
+
+	ctx->fragments = calloc(ctx->n_inputs + 1, sizeof(struct module*));
+
+	for (; ctx->n_fragments < ctx->n_inputs; ctx->n_fragments++) {
+		int i = ctx->n_fragments;
+
+		int ret = parse_input(&ctx->inputs[i], &ctx->fragments[i]);
+		if (ret > 0) {
+			forget_tree(ctx);
+			return leave(ret);
+		}
+	}
+
+	ctx->containers = list_new();
+	ctx->root = assemble_tree(
+		ctx->inputs, ctx->fragments, ctx->n_inputs, ctx->opts.desc,
+		ctx->containers
+	);
+
+	ctx->sources = calloc(ctx->n_inputs + 1, sizeof(struct source));
+	inputs_to_sources(ctx->inputs, ctx->n_inputs, ctx->sources);
+
+	return leave(0);
+}
+
+int docgen_generate(struct docgen* ctx, const char* output) {
+	enter(ctx);
+
+	if (ctx->root == NULL) {
+		errorf("inputs must be parsed before generating\n");
+		return leave(1);
+	}
+
+	return leave(generator_run_library(
+		ctx->gen, ctx->root, ctx->sources, ctx->opts.library, output
+	));
+}
+
+int docgen_generate_to(struct docgen* ctx, docgen_write write, void* user) {
+	enter(ctx);
+
+	if (ctx->root == NULL) {
+		errorf("inputs must be parsed before generating\n");
+		return leave(1);
+	}
+
+	return leave(generator_run_sink(
+		ctx->gen, ctx->root, ctx->sources, write, user
+	));
+}
+
+void docgen_free(struct docgen* ctx) {
+	if (ctx == NULL) return;
+
+	forget_tree(ctx);
+
+	for (int i = 0; i < ctx->n_inputs; i++) input_free(&ctx->inputs[i]);
+	free(ctx->inputs);
+
+	generator_free(ctx->gen);
+	free(ctx);
+}
@@ -0,0 +1,53 @@
+#ifndef DOCGEN_H
+#define DOCGEN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+	libnasaldocgen: generates documentation for nasal files in process
+
+	a context holds the inputs, the parsed module tree and the loaded template
+	for a single library; separate contexts may be used from different threads
+	at once, but a single context must only be used by one thread at a time
+
+	unless noted otherwise, functions return 0 on success, or else the same
+	status the program would exit with (1 for an argument error, 2 for an io
+	error and 3 for a processing error)
+*/
+
+struct docgen;
+
+struct docgen_options {
+	const char* library;  /* defaults to "globals" */
+	const char* desc;     /* defaults to "" */
+	const char* template; /* defaults to the installed template */
+	bool no_markdown;
+
+	// receives each error message rather than it being printed to stderr
+	void (* error)(const char* message, void* user);
+	void* error_user;
+};
+
+// receives each generated file; a nonzero return stops generation
+typedef int (* docgen_write)(
+	const char* path,
+	const char* data,
+	size_t length,
+	void* user
+);
+
+// returns NULL on failure, with the status set
+struct docgen* docgen_new(const struct docgen_options* opts, int* status);
+
+// module may be NULL, to derive it from the path as on the command line
+int docgen_add_input(struct docgen* ctx, const char* file, const char* module);
+int docgen_add_dir(struct docgen* ctx, const char* dir);
+
+int docgen_parse(struct docgen* ctx);
+int docgen_generate(struct docgen* ctx, const char* output);
+int docgen_generate_to(struct docgen* ctx, docgen_write write, void* user);
+
+void docgen_free(struct docgen* ctx);
+
+#endif // ifndef DOCGEN_H
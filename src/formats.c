@@ -0,0 +1,488 @@
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "formats.h"
+#include "generate.h"
+#include "parse.h"
+#include "util.h"
+
+static const char* types[] = { "var", "func", "class" };
+
+static int emit(
+	const char* path,
+	char* data,
+	size_t length,
+	generator_sink sink,
+	void* user
+) {
+	int ret = sink(path, data, length, user) ? 2 : 0;
+	free(data);
+
+	return ret;
+}
+
+// writes the signature of a function, e.g. `name(a, b = nil, rest...)`
+static void write_signature(FILE* out, struct item* item) {
+	fprintf(out, "%s(", item->name);
+
+	bool first = true;
+	LIST_ITER_T(item->items, param, struct param*) {
+		fprintf(out, "%s%s", first ? "" : ", ", param->name);
+		if (param->optional) fputs(" = nil", out);
+		if (param->variable) fputs("...", out);
+		first = false;
+	}
+
+	fputc(')', out);
+}
+
+// writes a JSON string, escaping what needs it
+static void json_string(FILE* out, const char* string) {
+	fputc('"', out);
+
+	for (const unsigned char* c = (const unsigned char*) string; *c; c++) {
+		switch (*c) {
+			case '"': fputs("\\\"", out); break;
+			case '\\': fputs("\\\\", out); break;
+			case '\n': fputs("\\n", out); break;
+			case '\r': fputs("\\r", out); break;
+			case '\t': fputs("\\t", out); break;
+
+			default:
+				if (*c < 0x20) fprintf(out, "\\u%04x", *c);
+				else fputc(*c, out);
+		}
+	}
+
+	fputc('"', out);
+}
+
+static char* child_path(const char* path, const char* name) {
+	return *path ? asprintf("%s.%s", path, name) : asprintf("%s", name);
+}
+
+// writes the members which modules and items have in common, with no braces
+static void json_common(
+	FILE* out,
+	struct generator* gen,
+	const char* kind,
+	const char* name,
+	const char* path,
+	const char* parent,
+	const char* raw,
+	const char* filename,
+	int line
+) {
+	fputs("\"kind\":", out);
+	json_string(out, kind);
+	fputs(",\"name\":", out);
+	json_string(out, name);
+	fputs(",\"path\":", out);
+	json_string(out, path);
+
+	if (parent) {
+		fputs(",\"parent\":", out);
+		json_string(out, parent);
+	}
+
+	// the rendered description is only held for as long as it is written
+	char* desc = raw ? generator_markdown(gen, raw) : NULL;
+	fputs(",\"desc\":", out);
+	json_string(out, desc ? desc : "");
+	fputs(",\"rawDesc\":", out);
+	json_string(out, raw ? raw : "");
+	free(desc);
+
+	fputs(",\"source\":", out);
+	if (filename) {
+		fputs("{\"file\":", out);
+		json_string(out, filename);
+		fprintf(out, ",\"line\":%d}", line);
+	} else {
+		fputs("null", out);
+	}
+}
+
+// with lines, each item is written as a line of its own after its parent
+static void json_item(
+	FILE* out,
+	struct generator* gen,
+	struct item* item,
+	const char* parent,
+	bool lines
+) {
+	char* path = child_path(parent, item->name);
+
+	fputc('{', out);
+	json_common(
+		out, gen, types[item->type], item->name, path, lines ? parent : NULL,
+		item->desc, item->filename, item->line
+	);
+
+	if (item->type == ITEM_FUNC) {
+		fputs(",\"params\":[", out);
+
+		bool first = true;
+		LIST_ITER_T(item->items, param, struct param*) {
+			fputs(first ? "{\"name\":" : ",{\"name\":", out);
+			json_string(out, param->name);
+			fprintf(
+				out, ",\"optional\":%s,\"variable\":%s}",
+				param->optional ? "true" : "false",
+				param->variable ? "true" : "false"
+			);
+			first = false;
+		}
+
+		fputc(']', out);
+	} else if (item->type == ITEM_CLASS && !lines) {
+		fputs(",\"items\":[", out);
+
+		bool first = true;
+		LIST_ITER_T(item->items, child, struct item*) {
+			if (!first) fputc(',', out);
+			json_item(out, gen, child, path, false);
+			first = false;
+		}
+
+		fputc(']', out);
+	}
+
+	fputc('}', out);
+
+	if (lines) {
+		fputc('\n', out);
+
+		if (item->type == ITEM_CLASS) {
+			LIST_ITER_T(item->items, child, struct item*)
+				json_item(out, gen, child, path, true);
+		}
+	}
+
+	free(path);
+}
+
+static void json_module(
+	FILE* out,
+	struct generator* gen,
+	struct module* module,
+	const char* path,
+	const char* parent,
+	bool lines
+) {
+	fputc('{', out);
+	json_common(
+		out, gen, "module", module->name, path, lines ? parent : NULL,
+		module->desc, module->filename, module->line
+	);
+
+	if (lines) {
+		fputs("}\n", out);
+
+		LIST_ITER_T(module->items, item, struct item*)
+			json_item(out, gen, item, path, true);
+	} else {
+		fputs(",\"items\":[", out);
+
+		bool first = true;
+		LIST_ITER_T(module->items, item, struct item*) {
+			if (!first) fputc(',', out);
+			json_item(out, gen, item, path, false);
+			first = false;
+		}
+
+		fputs("],\"modules\":[", out);
+	}
+
+	bool first = true;
+	LIST_ITER_T(module->children, child, struct module*) {
+		if (!first && !lines) fputc(',', out);
+
+		char* at = child_path(path, child->name);
+		json_module(out, gen, child, at, path, lines);
+		free(at);
+
+		first = false;
+	}
+
+	if (!lines) fputs("]}", out);
+}
+
+// writes the whole model as it walks the tree, so that nothing more than the
+// path of the current module is held in memory
+static int write_model(
+	FILE* out,
+	struct generator* gen,
+	struct module* root,
+	const char* library,
+	bool lines
+) {
+	if (lines) {
+		json_module(out, gen, root, "", NULL, true);
+	} else {
+		fputs("{\"library\":", out);
+		json_string(out, library);
+		fputs(",\"root\":", out);
+		json_module(out, gen, root, "", NULL, false);
+		fputs("}\n", out);
+	}
+
+	return ferror(out) ? 2 : 0;
+}
+
+int format_json(
+	struct generator* gen,
+	struct module* root,
+	const char* library,
+	generator_sink sink,
+	void* user
+) {
+	char* data;
+	size_t length;
+	FILE* out = open_memstream(&data, &length);
+	if (out == NULL) {
+		perrorf("failed to write the api model");
+		return 3;
+	}
+
+	write_model(out, gen, root, library, false);
+	fclose(out);
+
+	return emit("api.json", data, length, sink, user);
+}
+
+int emit_model(
+	struct generator* gen,
+	struct module* root,
+	const char* library,
+	const char* path,
+	bool lines
+) {
+	char* data;
+	size_t length;
+	FILE* out = open_memstream(&data, &length);
+	if (out == NULL) {
+		perrorf("failed to write model '%s'", path);
+		return 3;
+	}
+
+	int ret = write_model(out, gen, root, library, lines);
+	fclose(out);
+
+	if (ret == 0) ret = write_at(AT_FDCWD, path, data, length);
+	free(data);
+
+	return ret;
+}
+
+static void markdown_items(FILE* out, struct list* items, const char* prefix) {
+	LIST_ITER_T(items, item, struct item*) {
+		fprintf(out, "### %s `%s", types[item->type], prefix);
+		if (item->type == ITEM_FUNC) write_signature(out, item);
+		else fputs(item->name, out);
+		fputs("`\n\n", out);
+
+		if (item->desc && *item->desc) fprintf(out, "%s\n\n", item->desc);
+
+		if (item->type == ITEM_CLASS) {
+			char* class_prefix = asprintf("%s%s.", prefix, item->name);
+			markdown_items(out, item->items, class_prefix);
+			free(class_prefix);
+		}
+	}
+}
+
+static void markdown_module(
+	FILE* out,
+	struct module* module,
+	const char* path
+) {
+	if (*path) fprintf(out, "## %s\n\n", path);
+	if (module->desc && *module->desc) fprintf(out, "%s\n\n", module->desc);
+
+	char* prefix = *path ? asprintf("%s.", path) : asprintf("%s", "");
+	markdown_items(out, module->items, prefix);
+
+	LIST_ITER_T(module->children, child, struct module*) {
+		char* child_path = asprintf("%s%s", prefix, child->name);
+		markdown_module(out, child, child_path);
+		free(child_path);
+	}
+
+	free(prefix);
+}
+
+int format_markdown(
+	struct generator* gen,
+	struct module* root,
+	const char* library,
+	generator_sink sink,
+	void* user
+) {
+	(void) gen;
+
+	char* data;
+	size_t length;
+	FILE* out = open_memstream(&data, &length);
+	if (out == NULL) {
+		perrorf("failed to write markdown");
+		return 3;
+	}
+
+	fprintf(out, "# %s\n\n", library);
+	markdown_module(out, root, "");
+	fclose(out);
+
+	return emit("api.md", data, length, sink, user);
+}
+
+// writes text so that roff does not treat any of it as requests or escapes
+static void roff_text(FILE* out, const char* text, bool line_start) {
+	for (const char* c = text; *c; c++) {
+		if (line_start && (*c == '.' || *c == '\'')) fputs("\\&", out);
+
+		if (*c == '\\') fputs("\\e", out);
+		else if (*c == '"') fputs("\\(dq", out);
+		else fputc(*c, out);
+
+		line_start = *c == '\n';
+	}
+}
+
+// writes text as whole lines
+static void roff_lines(FILE* out, const char* text) {
+	roff_text(out, text, true);
+	if (*text && text[strlen(text) - 1] != '\n') fputc('\n', out);
+}
+
+static void man_items(
+	FILE* out,
+	struct list* items,
+	enum item_type type,
+	const char* heading,
+	const char* prefix
+) {
+	bool any = false;
+
+	LIST_ITER_T(items, item, struct item*) {
+		if (item->type != type) continue;
+
+		if (!any) fprintf(out, ".SH %s\n", heading);
+		any = true;
+
+		char* signature;
+		size_t length;
+		FILE* sig = open_memstream(&signature, &length);
+		if (sig == NULL) continue;
+		fputs(prefix, sig);
+		if (item->type == ITEM_FUNC) write_signature(sig, item);
+		else fputs(item->name, sig);
+		fclose(sig);
+
+		fputs(".TP\n.B \"", out);
+		roff_text(out, signature, false);
+		fputs("\"\n", out);
+		free(signature);
+
+		if (item->desc && *item->desc) roff_lines(out, item->desc);
+	}
+}
+
+static int man_module(
+	struct module* module,
+	const char* library,
+	const char* path,
+	generator_sink sink,
+	void* user
+) {
+	char* name = *path
+		? asprintf("%s.%s", library, path)
+		: asprintf("%s", library);
+
+	char* data;
+	size_t length;
+	FILE* out = open_memstream(&data, &length);
+	if (out == NULL) {
+		perrorf("failed to write man page");
+		free(name);
+		return 3;
+	}
+
+	fputs(".TH \"", out);
+	roff_text(out, name, false);
+	fputs("\" 3 \"\" \"", out);
+	roff_text(out, library, false);
+	fputs("\"\n.SH NAME\n", out);
+	roff_lines(out, name);
+
+	if (module->desc && *module->desc) {
+		fputs(".SH DESCRIPTION\n", out);
+		roff_lines(out, module->desc);
+	}
+
+	if (list_length(module->children)) {
+		fputs(".SH MODULES\n", out);
+		LIST_ITER_T(module->children, child, struct module*) {
+			fputs(".TP\n.BR \"", out);
+			roff_text(out, name, false);
+			fputc('.', out);
+			roff_text(out, child->name, false);
+			fputs("\" (3)\n", out);
+			if (child->desc && *child->desc) roff_lines(out, child->desc);
+		}
+	}
+
+	char* prefix = *path ? asprintf("%s.", path) : asprintf("%s", "");
+
+	man_items(out, module->items, ITEM_FUNC, "FUNCTIONS", prefix);
+	man_items(out, module->items, ITEM_VAR, "VARIABLES", prefix);
+
+	// classes are documented in place, with their members below them
+	LIST_ITER_T(module->items, item, struct item*) {
+		if (item->type != ITEM_CLASS) continue;
+
+		fputs(".SH \"CLASS ", out);
+		roff_text(out, item->name, false);
+		fputs("\"\n", out);
+		if (item->desc && *item->desc) roff_lines(out, item->desc);
+
+		char* class_prefix = asprintf("%s%s.", prefix, item->name);
+		man_items(out, item->items, ITEM_FUNC, "METHODS", class_prefix);
+		man_items(out, item->items, ITEM_VAR, "MEMBERS", class_prefix);
+		free(class_prefix);
+	}
+
+	fclose(out);
+
+	char* file = asprintf("man/%s.3", name);
+	int ret = emit(file, data, length, sink, user);
+	free(file);
+	free(name);
+
+	LIST_ITER_T(module->children, child, struct module*) {
+		if (ret > 0) break;
+
+		char* child_path = asprintf("%s%s", prefix, child->name);
+		ret = man_module(child, library, child_path, sink, user);
+		free(child_path);
+	}
+
+	free(prefix);
+
+	return ret;
+}
+
+int format_man(
+	struct generator* gen,
+	struct module* root,
+	const char* library,
+	generator_sink sink,
+	void* user
+) {
+	(void) gen;
+
+	return man_module(root, library, "", sink, user);
+}
@@ -0,0 +1,43 @@
+#ifndef FORMATS_H
+#define FORMATS_H
+
+#include <stdbool.h>
+
+#include "generate.h"
+#include "parse.h"
+
+// each writes the whole tree in one format, passing the files to the sink
+
+int format_json(
+	struct generator* gen,
+	struct module* root,
+	const char* library,
+	generator_sink sink,
+	void* user
+);
+int format_markdown(
+	struct generator* gen,
+	struct module* root,
+	const char* library,
+	generator_sink sink,
+	void* user
+);
+int format_man(
+	struct generator* gen,
+	struct module* root,
+	const char* library,
+	generator_sink sink,
+	void* user
+);
+
+// writes the model of the whole tree to the file at path, with each module and
+// item on a line of its own if lines is set
+int emit_model(
+	struct generator* gen,
+	struct module* root,
+	const char* library,
+	const char* path,
+	bool lines
+);
+
+#endif // ifndef FORMATS_H
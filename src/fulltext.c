@@ -0,0 +1,142 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fulltext.h"
+#include "util.h"
+
+/*
+	the full-text index maps each trigram of the words in the descriptions to
+	the documents it appears in; words are runs of ascii letters and digits,
+	compared without case, and a trigram is three consecutive characters of
+	one, with the code c0 * 36 * 36 + c1 * 36 + c2 where digits are 0-9 and
+	letters are 10-35
+
+	the trigrams are split over FULLTEXT_SHARDS shards by code modulo the number
+	of shards, so that a query only needs the shards of its own trigrams; each
+	is a json object from trigram to the increasing document ids it appears in,
+	with each id after the first stored as the difference from the one before
+*/
+
+#define ALPHABET 36
+#define TRIGRAMS (ALPHABET * ALPHABET * ALPHABET)
+
+struct postings {
+	uint32_t* docs;
+	uint32_t length, alloc;
+};
+
+static int char_value(char c) {
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'z') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'Z') return c - 'A' + 10;
+
+	return -1;
+}
+
+static void post(struct postings* postings, uint32_t doc) {
+	// the documents are indexed in order, so a repeat can only be the last one
+	if (postings->length > 0 && postings->docs[postings->length - 1] == doc)
+		return;
+
+	if (postings->length == postings->alloc) {
+		postings->alloc = postings->alloc ? postings->alloc * 2 : 4;
+		postings->docs = realloc(
+			postings->docs, postings->alloc * sizeof(uint32_t)
+		);
+	}
+
+	postings->docs[postings->length++] = doc;
+}
+
+static void index_desc(struct postings* index, const char* desc, uint32_t doc) {
+	int values[3] = { 0 };
+	int run = 0;
+
+	for (const char* c = desc; *c; c++) {
+		int value = char_value(*c);
+		if (value < 0) {
+			run = 0;
+			continue;
+		}
+
+		values[0] = values[1];
+		values[1] = values[2];
+		values[2] = value;
+
+		if (++run >= 3)
+			post(&index[(values[0] * ALPHABET + values[1]) * ALPHABET + value], doc);
+	}
+}
+
+static void write_trigram(FILE* out, int code) {
+	static const char chars[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+	fputc(chars[code / (ALPHABET * ALPHABET)], out);
+	fputc(chars[code / ALPHABET % ALPHABET], out);
+	fputc(chars[code % ALPHABET], out);
+}
+
+// returns FULLTEXT_SHARDS json strings, where the documents are identified by
+// their index in descs (which may have NULLs for documents with no text)
+char** fulltext_build(const char* descs[], size_t n_descs, size_t* n_trigrams) {
+	struct postings* index = calloc(TRIGRAMS, sizeof(struct postings));
+
+	for (size_t i = 0; i < n_descs; i++)
+		if (descs[i]) index_desc(index, descs[i], i);
+
+	char** shards = calloc(FULLTEXT_SHARDS, sizeof(char*));
+	*n_trigrams = 0;
+
+	for (int shard = 0; shard < FULLTEXT_SHARDS; shard++) {
+		size_t length;
+		FILE* out = open_memstream(&shards[shard], &length);
+		if (out == NULL) {
+			perrorf("failed to write full-text index");
+			fulltext_free(shards);
+			shards = NULL;
+			break;
+		}
+
+		fputc('{', out);
+
+		bool first = true;
+		for (int code = shard; code < TRIGRAMS; code += FULLTEXT_SHARDS) {
+			struct postings* postings = &index[code];
+			if (postings->length == 0) continue;
+
+			fputs(first ? "\"" : ",\"", out);
+			write_trigram(out, code);
+			fputs("\":[", out);
+
+			for (uint32_t i = 0; i < postings->length; i++) {
+				uint32_t doc = postings->docs[i];
+				uint32_t delta = i ? doc - postings->docs[i - 1] : doc;
+
+				fprintf(out, i ? ",%u" : "%u", delta);
+			}
+
+			fputc(']', out);
+
+			first = false;
+			(*n_trigrams)++;
+		}
+
+		fputc('}', out);
+		fclose(out);
+	}
+
+	for (int code = 0; code < TRIGRAMS; code++) free(index[code].docs);
+	free(index);
+
+	return shards;
+}
+
+void fulltext_free(char** shards) {
+	if (shards == NULL) return;
+
+	for (int shard = 0; shard < FULLTEXT_SHARDS; shard++) free(shards[shard]);
+	free(shards);
+}
@@ -0,0 +1,11 @@
+#ifndef FULLTEXT_H
+#define FULLTEXT_H
+
+#include <stddef.h>
+
+#define FULLTEXT_SHARDS 64
+
+char** fulltext_build(const char* descs[], size_t n_descs, size_t* n_trigrams);
+void fulltext_free(char** shards);
+
+#endif // ifndef FULLTEXT_H
@@ -1,12 +1,19 @@
+#include <ctype.h>
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <sys/ioctl.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <cmark.h>
@@ -15,12 +22,28 @@
 
 #include <lattice/lattice-cjson.h>
 
+#include <linux/fs.h>
+
+#include "compress.h"
+#include "formats.h"
+#include "fulltext.h"
 #include "generate.h"
+#include "manifest.h"
 #include "parse.h"
+#include "symbols.h"
 #include "util.h"
 
-#define DIR_FLAGS  (S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH)
-#define FILE_FLAGS (S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH)
+#define DIR_FLAGS (S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH)
+
+struct buffer {
+	char* data;
+	size_t length;
+};
+
+static void buffer_free(struct buffer* buffer) {
+	free(buffer->data);
+	free(buffer);
+}
 
 struct templates {
 	const char *dir;
@@ -28,381 +51,1677 @@ struct templates {
 	char* list;
 	char* module;
 	char* source;
+	char* app; /* only with spa */
 };
 
-struct ctx {
-	DIR* output;
+struct generator {
+	struct generate_options opts;
 	struct templates templates;
+	struct map* statics;  /* file name -> buffer */
+	struct map* static_names; /* file name -> hashed name, with hash_statics */
+	cJSON* assets; /* template variable -> output name of each static */
+	struct map* markdown; /* raw desc -> rendered desc */
+	struct map* pages;    /* output path -> hash of last rendered input */
+	struct map* rendered; /* output path -> buffer, when rendering lazily */
+	struct map* depends;  /* output path -> map of input paths */
+	struct manifest* manifest; /* files written to the output, with manifest */
+	struct generator* memo; /* whose markdown memo and lock are used */
+	struct list* themes;    /* generator, for each extra template */
+	char* theme_output;
+	bool statics_dirty;
+	char generated[16]; /* date of generation, for the page footers */
+	pthread_mutex_t lock;
+};
+
+struct ctx {
+	struct generator* gen;
+	int output; /* -1 with a sink */
+	const char* path;
 	struct list* stack;
 	const struct generate_options *opts;
+	generator_sink sink;
+	void* sink_user;
+	struct map* aliases; /* source alias -> file, when recording dependencies */
+	struct list* deps;   /* aliases the page depends on; NULL for all sources */
+	struct compressor* compressor; /* with precompress */
+	struct manifest* manifest;     /* of the generator's own output */
 };
 
 static int document_module(struct ctx ctx, struct module* module);
 static int document_item(struct ctx ctx, struct item* item);
 static int document_list(struct ctx ctx, struct module* root);
+static int document_app(struct ctx ctx, struct module* root);
+static int document_search(struct ctx ctx, struct module* root);
 static int document_sources(struct ctx ctx, struct source sources[]);
+static int document_selected(
+	struct ctx ctx,
+	struct module* root,
+	const char* selector
+);
+static int copy_statics(struct ctx ctx);
+static void* keep_static(const char* name, void* buffer, void* user);
+// writes a file for another format, creating any directories in its path
+static int write_output(
+	const char* path,
+	const char* data,
+	size_t length,
+	void* user
+);
+static struct map* load_statics(const char* dir);
+static void hash_statics(struct generator* gen);
+static cJSON* assets_to_json(struct generator* gen);
+static cJSON* module_to_json(struct ctx ctx, struct module* module);
+static int render_page(
+	struct ctx ctx,
+	const char* name,
+	const char* template,
+	cJSON* json,
+	const char* what
+);
+static struct buffer* render_buffer(
+	struct ctx ctx,
+	const char* template,
+	cJSON* json,
+	const char* what
+);
+static int make_dir(struct ctx ctx, const char* name);
+static void depend(struct ctx ctx, const char* path, const char* file);
+static void free_depends(struct map* files);
+static void depend_page(
+	struct ctx ctx,
+	const char* path,
+	const char* template
+);
+static int write_depfile(struct generator* gen, const char* output);
+static int open_output(const char* output);
+static int generate(
+	struct ctx ctx,
+	struct module* root,
+	struct source sources[]
+);
 static char* default_template();
-static char* load_template(const char* dir, const char* name);
+static char* load_template(struct generator* gen, const char* name);
 
-int generate_docs(
-	struct module* root,
-	struct source sources[],
-	struct generate_options opts
-) {
-	const char* template = opts.template;
-	if (template == NULL) template = default_template();
+struct generator* generator_new(struct generate_options opts, int* status) {
+	struct generator* gen = calloc(1, sizeof(struct generator));
+	gen->opts = opts;
 
-	if (template == NULL) {
+	if (opts.template) {
+		gen->templates.dir = astrndup(opts.template, strlen(opts.template));
+	} else if (!(gen->templates.dir = default_template())) {
 		perrorf("failed to find template directory");
-		return 3;
-	}
 
-	if (mkdir(opts.output, DIR_FLAGS) == -1) {
-		if (errno != EEXIST) {
-			perrorf("failed to create output dir");
-			return 2;
-		}
+		free(gen);
+		*status = 3;
+		return NULL;
 	}
 
-	struct ctx ctx = {
-		.output = opendir(opts.output),
-		.templates = {
-			.dir = template,
-			.item = load_template(template, "item"),
-			.list = load_template(template, "list"),
-			.module = load_template(template, "module"),
-			.source = load_template(template, "source"),
-		},
-		.stack = list_new(),
-		.opts = &opts,
-	};
-
-	if (
-		!ctx.templates.item ||
-		!ctx.templates.list ||
-		!ctx.templates.module ||
-		!ctx.templates.source
-	) return 2;
+	// the date is taken from SOURCE_DATE_EPOCH when it is set, so that the same
+	// inputs always give the same output
+	time_t now = time(NULL);
+	const char* epoch = getenv("SOURCE_DATE_EPOCH");
+	if (epoch && epoch[0]) {
+		char* end;
+		long long value = strtoll(epoch, &end, 10);
 
-	int ret;
+		if (*end == 0 && value >= 0) now = value;
+		else errorf("SOURCE_DATE_EPOCH is not a number of seconds, ignoring\n");
+	}
 
-	ret = document_list(ctx, root);
-	if (ret > 0) return ret;
+	struct tm date;
+	gmtime_r(&now, &date);
+	strftime(gen->generated, sizeof(gen->generated), "%Y-%m-%d", &date);
 
-	ret = document_sources(ctx, sources);
-	if (ret > 0) return ret;
+	// with several outputs from one run, markdown is only rendered once; the
+	// model counts as one, so that it has the same descriptions as the pages
+	bool outputs = opts.themes || opts.model || (opts.formats & ~FORMAT_HTML);
+	if (opts.memoise || outputs) gen->markdown = map_new();
+	if (opts.incremental) gen->pages = map_new();
+	if (opts.depfile) gen->depends = map_new();
+	if (opts.manifest) gen->manifest = manifest_new();
 
-	ret = document_module(ctx, root);
-	if (ret > 0) return ret;
+	gen->memo = gen;
+	pthread_mutex_init(&gen->lock, NULL);
 
-	char *path = asprintf("%s/static/", template);
-	DIR *template_static = opendir(path);
-	free(path);
+	if ((*status = generator_reload(gen))) {
+		generator_free(gen);
+		return NULL;
+	}
 
-	if (!template_static) {
-		if (errno == ENOENT) goto no_statics;
+	if (opts.themes) {
+		gen->themes = list_new();
+
+		for (const char** theme = opts.themes; *theme; theme++) {
+			// each theme goes to a subdir of the output named after its template
+			size_t length = strlen(*theme);
+			while (length > 1 && (*theme)[length - 1] == '/') length--;
+
+			const char* name = *theme + length;
+			while (name > *theme && name[-1] != '/') name--;
+
+			struct generate_options theme_opts = {
+				.library = opts.library,
+				.template = *theme,
+				.no_markdown = opts.no_markdown,
+				.incremental = opts.incremental,
+				.aggregate = opts.aggregate,
+				.shard_list = opts.shard_list,
+				.full_text = opts.full_text,
+				.spa = opts.spa,
+				.precompress = opts.precompress,
+				.minify = opts.minify,
+				.hash_statics = opts.hash_statics,
+				.manifest = opts.manifest,
+				.static_store = opts.static_store,
+			};
+
+			char* output = asprintf(
+				"%s/%.*s", opts.output, (int) (*theme + length - name), name
+			);
+			theme_opts.output = output;
+
+			struct generator* child = generator_new(theme_opts, status);
+			if (child == NULL) {
+				free(output);
+				generator_free(gen);
+				return NULL;
+			}
 
-		perrorf("failed to open template static files directory");
-		return 2;
+			child->theme_output = output;
+			child->memo = gen;
+			list_push(gen->themes, child);
+		}
 	}
 
-	struct dirent *dirent;
-	char buf[8192];
-	ssize_t read_result, write_result;
+	return gen;
+}
 
-	while ((dirent = readdir(template_static))) {
-		if (dirent->d_type != DT_REG) continue;
+int generator_reload(struct generator* gen) {
+	free(gen->templates.item);
+	free(gen->templates.list);
+	free(gen->templates.module);
+	free(gen->templates.source);
+	free(gen->templates.app);
+
+	gen->templates.item = load_template(gen, "item");
+	gen->templates.list = load_template(gen, "list");
+	gen->templates.module = load_template(gen, "module");
+	gen->templates.source = load_template(gen, "source");
+	gen->templates.app = gen->opts.spa
+		? load_template(gen, "app")
+		: NULL;
 
-		int in_fd = openat(dirfd(template_static), dirent->d_name, O_RDONLY);
-		int out_fd = openat(
-			dirfd(ctx.output), dirent->d_name, O_CREAT | O_WRONLY | O_TRUNC, FILE_FLAGS
-		);
+	if (
+		!gen->templates.item ||
+		!gen->templates.list ||
+		!gen->templates.module ||
+		!gen->templates.source ||
+		(gen->opts.spa && !gen->templates.app)
+	) return 2;
 
-		while ((read_result = read(in_fd, &buf[0], sizeof(buf)))) {
-			if (read_result < 0) {
-				perrorf("failed to copy static file");
-				return 2;
-			}
+	// every page depends on the templates, so forget what was rendered before
+	if (gen->pages) {
+		map_free(gen->pages, free);
+		gen->pages = map_new();
+	}
 
-			write_result = write(out_fd, &buf[0], read_result);
-			if (write_result < 0 || write_result != read_result) {
-				perrorf("failed to copy static file");
-				return 2;
-			}
-		}
+	map_free(gen->rendered, (void (*)(void*)) buffer_free);
+	gen->rendered = NULL;
 
-		close(in_fd);
-		close(out_fd);
-	}
+	map_free(gen->statics, (void (*)(void*)) buffer_free);
+	if (!(gen->statics = load_statics(gen->templates.dir))) return 2;
 
-	closedir(template_static);
+	map_free(gen->static_names, free);
+	gen->static_names = NULL;
+	if (gen->opts.hash_statics) hash_statics(gen);
 
-no_statics:
-	closedir(ctx.output);
-	free(ctx.templates.item);
-	free(ctx.templates.list);
-	free(ctx.templates.module);
-	free(ctx.templates.source);
-	list_free(ctx.stack, NULL);
+	cJSON_Delete(gen->assets);
+	gen->assets = assets_to_json(gen);
+
+	gen->statics_dirty = true;
 
-	if (opts.template == NULL) free((char*) template);
+	if (gen->themes) {
+		LIST_ITER_T(gen->themes, theme, struct generator*) {
+			int ret = generator_reload(theme);
+			if (ret > 0) return ret;
+		}
+	}
 
 	return 0;
 }
 
-static bool check_template(const char* path) {
-	DIR* dir = opendir(path);
-	if (!dir) return false;
-	closedir(dir);
-	return true;
+const char* generator_template(struct generator* gen) {
+	return gen->templates.dir;
 }
 
-static char* default_template() {
-	const char* dirs;
-	if ((dirs = getenv("XDG_DATA_DIRS"))) {
-		do {
-			int length = strcspn(dirs, ":");
+void generator_free(struct generator* gen) {
+	if (gen == NULL) return;
+
+	free((char*) gen->templates.dir);
+	free(gen->templates.item);
+	free(gen->templates.list);
+	free(gen->templates.module);
+	free(gen->templates.source);
+	free(gen->templates.app);
+	map_free(gen->markdown, free);
+	map_free(gen->pages, free);
+	map_free(gen->rendered, (void (*)(void*)) buffer_free);
+	map_free(gen->statics, (void (*)(void*)) buffer_free);
+	map_free(gen->static_names, free);
+	cJSON_Delete(gen->assets);
+	map_free(gen->depends, (void (*)(void*)) free_depends);
+	manifest_free(gen->manifest);
+	list_free(gen->themes, (void (*)(void*)) generator_free);
+	free(gen->theme_output);
+	pthread_mutex_destroy(&gen->lock);
+
+	free(gen);
+}
 
-			char* test = asprintf("%.*s/" NAME "/template", length, dirs);
-			if (check_template(test)) return test;
-			free(test);
+int generator_run(
+	struct generator* gen,
+	struct module* root,
+	struct source sources[]
+) {
+	struct ctx ctx = {
+		.gen = gen,
+		.output = open_output(gen->opts.output),
+		.opts = &gen->opts,
+		.manifest = gen->manifest,
+	};
 
-			dirs += length + 1;
-		} while (dirs[-1]);
+	if (ctx.output == -1) return 2;
+
+	// only what is generated by this run is depended upon
+	if (gen->depends) {
+		map_free(gen->depends, (void (*)(void*)) free_depends);
+		gen->depends = map_new();
 	}
 
-	if (check_template("/usr/share/" NAME "/template"))
-		return "/usr/share/" NAME "/template";
-	if (check_template("/usr/share/local/" NAME "/template"))
-		return "/usr/share/local/" NAME "/template";
+	if (gen->manifest) manifest_clear(gen->manifest);
 
-	return NULL;
-}
+	int ret = generate(ctx, root, sources);
 
-static char* load_template(const char* dir, const char* name) {
-	char* filename = asprintf("%s/pages/%s.html", dir, name);
-	char* contents = read_file(filename);
-	free(filename);
+	// with --only, the files which were not selected are kept as they are
+	if (ret == 0 && gen->manifest)
+		ret = manifest_finish(gen->manifest, ctx.output, !gen->opts.only);
 
-	return contents;
+	close(ctx.output);
+
+	if (ret == 0 && gen->depends) ret = write_depfile(gen, gen->opts.output);
+	if (ret == 0 && gen->opts.symbols) {
+		enum symbols_layout layout =
+			gen->opts.spa ? LAYOUT_SPA :
+			gen->opts.aggregate ? LAYOUT_AGGREGATE :
+			LAYOUT_PAGES;
+
+		ret = write_symbols(gen->opts.symbols, gen->opts.library, root, layout);
+	}
+	if (ret == 0 && gen->opts.model) {
+		ret = emit_model(
+			gen, root, gen->opts.library, gen->opts.model, gen->opts.model_lines
+		);
+	}
+
+	if (gen->themes) {
+		LIST_ITER_T(gen->themes, theme, struct generator*)
+			if (ret == 0) ret = generator_run(theme, root, sources);
+	}
+
+	return ret;
 }
 
-static cJSON* module_to_json(
-	struct module* module,
-	struct list* stack,
-	const struct generate_options *opts
+// runs for a different library and output than the generator was created for,
+// which may be done from several threads at once so long as the generator is
+// neither incremental nor being reloaded
+int generator_run_library(
+	struct generator* gen,
+	struct module* root,
+	struct source sources[],
+	const char* library,
+	const char* output
 ) {
-	char crumbs[list_length(stack) * 3 + 1];
+	struct generate_options opts = gen->opts;
+	opts.library = library;
+	opts.output = output;
+	opts.only = NULL;
 
-	crumbs[0] = 0;
-	for (int i = 0; i < list_length(stack); i++) strcpy(crumbs + i * 3, "../");
+	struct ctx ctx = {
+		.gen = gen,
+		.output = open_output(output),
+		.opts = &opts,
+	};
 
-	cJSON* root = cJSON_CreateObject();
+	if (ctx.output == -1) return 2;
 
-	cJSON_AddStringToObject(root, "name", module->name);
-	cJSON_AddStringToObject(root, "root", crumbs);
-	cJSON_AddStringToObject(root, "library", opts->library);
+	int ret = generate(ctx, root, sources);
+	close(ctx.output);
 
-	if (module->desc != NULL) {
-		char* desc;
-		if (opts->no_markdown) {
-			size_t allocate = 12;
-			for (char *ch = module->desc; *ch; ch++)
-				allocate += (*ch == '<' || *ch == '>' || *ch == '&') ? 5 : 1;
-
-			desc = malloc(allocate);
-			strcpy(desc, "<pre>");
-
-			for (size_t i = 0, j = 5; module->desc[i]; i++, j++) {
-				char ch = module->desc[i];
-				desc[j] = ch;
-
-				if (ch == '<' || ch == '>' || ch == '&') {
-					sprintf(desc + j, "&#%02d;", module->desc[i]);
-					j += 4;
-				}
-			}
+	return ret;
+}
 
-			strcpy(desc + allocate - 7, "</pre>");
-		} else {
-			desc = cmark_markdown_to_html(module->desc, strlen(module->desc), 0);
-		}
+// passes every file to sink rather than writing to the output dir; like
+// generator_run_library, this may be done from several threads at once
+int generator_run_sink(
+	struct generator* gen,
+	struct module* root,
+	struct source sources[],
+	generator_sink sink,
+	void* user
+) {
+	struct generate_options opts = gen->opts;
 
-		cJSON_AddStringToObject(root, "desc", desc);
-		cJSON_AddStringToObject(root, "rawDesc", module->desc);
+	struct ctx ctx = {
+		.gen = gen,
+		.output = -1,
+		.opts = &opts,
+		.sink = sink,
+		.sink_user = user,
+	};
 
-		free(desc);
-	} else {
-		cJSON_AddStringToObject(root, "desc", "");
-		cJSON_AddStringToObject(root, "rawDesc", "");
-	}
+	return generate(ctx, root, sources);
+}
 
-	cJSON* parents = cJSON_AddArrayToObject(root, "parents");
-	LIST_ITER_T(stack, ancestor, const char*)
-		cJSON_AddItemToArray(parents, cJSON_CreateString(ancestor));
+static int generate(
+	struct ctx ctx,
+	struct module* root,
+	struct source sources[]
+) {
+	const struct generate_options* opts = ctx.opts;
+	struct generator* gen = ctx.gen;
 
-	if (module->filename) {
-		cJSON* source = cJSON_AddObjectToObject(root, "source");
+	ctx.path = "";
+	ctx.stack = list_new();
 
-		cJSON_AddStringToObject(source, "file", module->filename);
-		cJSON_AddNumberToObject(source, "line", (double) module->line);
-	} else {
-		cJSON_AddNullToObject(root, "source");
+	if (gen->depends) {
+		ctx.aliases = map_new();
+		for (struct source* source = sources; source->file; source++)
+			map_set(ctx.aliases, source->alias, (void*) source->file);
 	}
 
-	cJSON* children = cJSON_AddArrayToObject(root, "modules");
-	cJSON* items[3] = {
-		cJSON_AddArrayToObject(root, "vars"),
-		cJSON_AddArrayToObject(root, "funcs"),
-		cJSON_AddArrayToObject(root, "classes"),
+	// compression happens on other threads while the rest is rendered
+	if (opts->precompress && !ctx.sink)
+		ctx.compressor = compressor_new(ctx.output);
+
+	int ret = 0;
+	unsigned formats = opts->formats ? opts->formats : FORMAT_HTML;
+
+	if ((formats & FORMAT_HTML) && opts->spa) {
+		if ((ret = document_app(ctx, root)) > 0) goto end;
+		if ((ret = document_sources(ctx, sources)) > 0) goto end;
+	} else if ((formats & FORMAT_HTML) && opts->only) {
+		if (opts->only_list && (ret = document_list(ctx, root)) > 0)
+			goto end;
+		if (opts->only_sources && (ret = document_sources(ctx, sources)) > 0)
+			goto end;
+
+		for (const char** selector = opts->only; *selector; selector++)
+			if ((ret = document_selected(ctx, root, *selector)) > 0) goto end;
+	} else if (formats & FORMAT_HTML) {
+		if ((ret = document_list(ctx, root)) > 0) goto end;
+		if ((ret = document_sources(ctx, sources)) > 0) goto end;
+		if ((ret = document_module(ctx, root)) > 0) goto end;
+	}
+
+	// the statics only need writing again when they may have changed, unless
+	// this is a different output to the one the generator is for
+	if ((formats & FORMAT_HTML) && (gen->statics_dirty || opts != &gen->opts)) {
+		if ((ret = copy_statics(ctx)) > 0) goto end;
+		if (opts == &gen->opts) gen->statics_dirty = false;
+	} else if ((formats & FORMAT_HTML) && ctx.manifest) {
+		map_iter(gen->statics, keep_static, &ctx);
+	}
+
+	// the other formats are serialised from the same tree, and always cover all
+	// of it
+	struct format {
+		enum output_format format;
+		int (* write)(
+			struct generator*, struct module*, const char*, generator_sink, void*
+		);
+	} others[] = {
+		{ FORMAT_JSON, format_json },
+		{ FORMAT_MARKDOWN, format_markdown },
+		{ FORMAT_MAN, format_man },
 	};
 
-	LIST_ITER_T(module->children, child, struct module*) {
-		cJSON* nd = cJSON_CreateObject();
+	for (size_t i = 0; i < sizeof(others) / sizeof(others[0]); i++) {
+		if (!(formats & others[i].format)) continue;
 
-		cJSON_AddStringToObject(nd, "name", child->name);
-		cJSON_AddStringToObject(nd, "desc", child->desc ? child->desc : "");
+		ret = others[i].write(gen, root, opts->library, write_output, &ctx);
+		if (ret > 0) goto end;
+	}
 
-		cJSON_AddItemToArray(children, nd);
+end:
+	if (ctx.compressor) {
+		int compress_ret = compressor_finish(ctx.compressor);
+		if (compress_ret > ret) ret = compress_ret;
 	}
 
-	LIST_ITER_T(module->items, item, struct item*) {
-		cJSON* nd = cJSON_CreateObject();
+	list_free(ctx.stack, NULL);
+	map_free(ctx.aliases, NULL);
 
-		cJSON_AddStringToObject(nd, "name", item->name);
-		cJSON_AddStringToObject(nd, "desc", item->desc);
+	return ret;
+}
 
-		cJSON_AddItemToArray(items[item->type], nd);
+static int open_output(const char* output) {
+	if (mkdir(output, DIR_FLAGS) == -1) {
+		if (errno != EEXIST) {
+			perrorf("failed to create output dir");
+			return -1;
+		}
 	}
 
-	static const char* keys[4] = { "modules", "vars", "funcs", "classes" };
-	for (int i = 0; i < 4; i++)
-		if (cJSON_GetArraySize(cJSON_GetObjectItem(root, keys[i])) == 0)
-			cJSON_ReplaceItemInObject(root, keys[i], cJSON_CreateNull());
+	int fd = open(output, O_DIRECTORY);
+	if (fd == -1) perrorf("failed to open output dir");
 
-	return root;
+	return fd;
 }
 
-static int document_module(struct ctx ctx, struct module* module) {
-	int fd = openat(
-		dirfd(ctx.output), "index.html", O_CREAT | O_WRONLY | O_TRUNC, FILE_FLAGS
-	);
-	if (fd == -1) {
-		perrorf("failed to open output");
-		return 2;
-	}
+// documents everything except the modules below the root, which are expected
+// to be documented separately with generator_run_module; root may therefore be
+// a summary of the tree, as long as it has all of the names in it
+int generator_run_index(
+	struct generator* gen,
+	struct module* root,
+	struct source sources[]
+) {
+	struct ctx ctx = {
+		.gen = gen,
+		.output = open_output(gen->opts.output),
+		.path = "",
+		.stack = list_new(),
+		.opts = &gen->opts,
+		.manifest = gen->manifest,
+	};
 
-	FILE *file = fdopen(fd, "w");
-	if (!file) {
-		perrorf("failed to open output");
-		return 2;
-	}
+	if (ctx.output == -1) return 2;
+	if (gen->opts.precompress) ctx.compressor = compressor_new(ctx.output);
 
-	cJSON* json = module_to_json(module, ctx.stack, ctx.opts);
+	int ret;
 
-	lattice_error *err = NULL;
-	const char *search[] = { ctx.templates.dir, NULL };
-	lattice_opts opts = { .search = search, .ignore_emit_zero = true };
-	lattice_cjson_file(ctx.templates.module, json, file, opts, &err);
+	if ((ret = document_list(ctx, root)) > 0) goto end;
+	if ((ret = document_sources(ctx, sources)) > 0) goto end;
 
-	fclose(file);
+	cJSON* json = module_to_json(ctx, root);
+	ret = render_page(ctx, "index.html", gen->templates.module, json, "module");
 	cJSON_Delete(json);
 
-	if (err) {
-		perrorf("failed to render module template (%s)", err->message);
+	if (ret > 0) goto end;
 
-		lattice_error_code code = err->code;
-		lattice_error_free(err);
-		return code == LATTICE_IO_ERROR ? 2 : 3;
+	if (gen->statics_dirty) {
+		if ((ret = copy_statics(ctx)) > 0) goto end;
+		gen->statics_dirty = false;
+	} else if (ctx.manifest) {
+		map_iter(gen->statics, keep_static, &ctx);
 	}
 
-	DIR* dir = ctx.output;
-	list_push(ctx.stack, module->name);
+	// the index is documented after every module, so the run is done
+	if (ctx.manifest) ret = manifest_finish(ctx.manifest, ctx.output, true);
 
-	LIST_ITER_T(module->items, item, struct item*) {
-		int ret = document_item(ctx, item);
-		if (ret > 0) return ret;
+end:
+	if (ctx.compressor) {
+		int compress_ret = compressor_finish(ctx.compressor);
+		if (compress_ret > ret) ret = compress_ret;
 	}
 
-	LIST_ITER_T(module->children, child, struct module*) {
-		if (mkdirat(dirfd(dir), child->name, DIR_FLAGS) == -1) {
-			if (errno != EEXIST) {
-				perrorf("failed to create output dir");
-				return 2;
-			}
-		}
+	close(ctx.output);
+	list_free(ctx.stack, NULL);
 
-		int fd = openat(dirfd(dir), child->name, O_DIRECTORY);
-		ctx.output = fdopendir(fd);
+	return ret;
+}
 
-		int ret = document_module(ctx, child);
-		closedir(ctx.output);
-		if (ret > 0) return ret;
+// documents a module directly below the root, and everything within it
+int generator_run_module(struct generator* gen, struct module* module) {
+	struct ctx ctx = {
+		.gen = gen,
+		.output = open_output(gen->opts.output),
+		.path = "",
+		.stack = list_new(),
+		.opts = &gen->opts,
+		.manifest = gen->manifest,
+	};
+
+	if (ctx.output == -1) return 2;
+	if (gen->opts.precompress) ctx.compressor = compressor_new(ctx.output);
+
+	int ret = make_dir(ctx, module->name);
+
+	if (ret == 0) {
+		list_push(ctx.stack, "");
+
+		ctx.path = asprintf("%s/", module->name);
+		ret = document_module(ctx, module);
+		free((char*) ctx.path);
 	}
 
-	ctx.output = dir;
-	list_pop(ctx.stack);
+	if (ctx.compressor) {
+		int compress_ret = compressor_finish(ctx.compressor);
+		if (compress_ret > ret) ret = compress_ret;
+	}
 
-	return 0;
+	close(ctx.output);
+	list_free(ctx.stack, NULL);
+
+	return ret;
 }
 
-static cJSON* item_to_json(
-	struct item* item,
-	struct list* stack,
-	const struct generate_options *opts
+int generate_docs(
+	struct module* root,
+	struct source sources[],
+	struct generate_options opts
 ) {
-	int crumb_limit = list_length(stack) - (item->type != ITEM_CLASS);
-	char crumbs[crumb_limit * 3 + 1];
-
-	crumbs[0] = 0;
-	for (int i = 0; i < crumb_limit; i++) strcpy(crumbs + i * 3, "../");
+	int ret;
 
-	cJSON* root = cJSON_CreateObject();
+	struct generator* gen = generator_new(opts, &ret);
+	if (gen == NULL) return ret;
 
-	cJSON_AddStringToObject(root, "name", item->name);
-	cJSON_AddStringToObject(root, "root", crumbs);
-	cJSON_AddStringToObject(root, "library", opts->library);
+	ret = generator_run(gen, root, sources);
+	generator_free(gen);
 
-	static const char* types[] = { "var", "func", "class" };
-	cJSON_AddStringToObject(root, "type", types[item->type]);
+	return ret;
+}
 
-	if (item->desc != NULL) {
-		char* desc;
-		if (opts->no_markdown) {
-			size_t allocate = 12;
-			for (char *ch = item->desc; *ch; ch++)
-				allocate += (*ch == '<' || *ch == '>' || *ch == '&') ? 5 : 1;
-
-			desc = malloc(allocate);
-			strcpy(desc, "<pre>");
-
-			for (size_t i = 0, j = 5; item->desc[i]; i++, j++) {
-				char ch = item->desc[i];
-				desc[j] = ch;
-
-				if (ch == '<' || ch == '>' || ch == '&') {
-					sprintf(desc + j, "&#%02d;", item->desc[i]);
-					j += 4;
-				}
-			}
+static struct map* load_statics(const char* dir) {
+	struct map* statics = map_new();
 
-			strcpy(desc + allocate - 7, "</pre>");
-		} else {
-			desc = cmark_markdown_to_html(item->desc, strlen(item->desc), 0);
-		}
+	char *path = asprintf("%s/static/", dir);
+	DIR *template_static = opendir(path);
+	free(path);
 
-		cJSON_AddStringToObject(root, "desc", desc);
-		cJSON_AddStringToObject(root, "rawDesc", item->desc);
+	if (!template_static) {
+		if (errno == ENOENT) return statics;
 
-		free(desc);
-	} else {
-		cJSON_AddStringToObject(root, "desc", "");
-		cJSON_AddStringToObject(root, "rawDesc", "");
+		perrorf("failed to open template static files directory");
+		map_free(statics, NULL);
+		return NULL;
 	}
 
-	cJSON* parents = cJSON_AddArrayToObject(root, "parents");
-	LIST_ITER_T(stack, ancestor, const char*)
-		cJSON_AddItemToArray(parents, cJSON_CreateString(ancestor));
+	struct dirent *dirent;
+	char buf[8192];
+	ssize_t read_result;
+
+	while ((dirent = readdir(template_static))) {
+		if (dirent->d_type != DT_REG) continue;
+
+		int in_fd = openat(dirfd(template_static), dirent->d_name, O_RDONLY);
+		if (in_fd == -1) {
+			perrorf("failed to read static file");
+			break;
+		}
+
+		struct buffer* buffer = malloc(sizeof(struct buffer));
+		FILE* file = open_memstream(&buffer->data, &buffer->length);
+
+		while ((read_result = read(in_fd, &buf[0], sizeof(buf))) > 0)
+			fwrite(&buf[0], 1, read_result, file);
+
+		fclose(file);
+		close(in_fd);
+
+		map_set(statics, dirent->d_name, buffer);
+
+		if (read_result < 0) {
+			perrorf("failed to read static file");
+			break;
+		}
+	}
+
+	closedir(template_static);
+
+	if (dirent) {
+		map_free(statics, (void (*)(void*)) buffer_free);
+		return NULL;
+	}
+
+	return statics;
+}
+
+// the name a static is written as, with the hash of its contents before the
+// extension (style.css becomes style.3f9a1c0d5e7b2a64.css)
+static char* hashed_name(const char* name, const struct buffer* buffer) {
+	uint64_t hash = hash_bytes(buffer->data, buffer->length, 0);
+
+	const char* dot = strrchr(name, '.');
+	if (!dot || dot == name) return asprintf("%s.%016" PRIx64, name, hash);
+
+	return asprintf(
+		"%.*s.%016" PRIx64 "%s", (int) (dot - name), name, hash, dot
+	);
+}
+
+static bool is_css(const char* name) {
+	size_t length = strlen(name);
+	return length > 4 && strcmp(name + length - 4, ".css") == 0;
+}
+
+// points the url()s of a stylesheet that name other statics at their hashed
+// names, so that the stylesheet's own hash changes with theirs
+static void rewrite_css(struct map* names, struct buffer* buffer) {
+	struct buffer* rewritten = malloc(sizeof(struct buffer));
+	FILE* file = open_memstream(&rewritten->data, &rewritten->length);
+
+	const char* at = buffer->data;
+	const char* end = buffer->data + buffer->length;
+
+	for (const char* url; (url = strstr(at, "url(")) && url < end;) {
+		const char* start = url + 4;
+		while (start < end && (*start == ' ' || *start == '\'' || *start == '"'))
+			start++;
+
+		size_t length = strcspn(start, "'\") \t\n");
+		char* target = astrndup(start, length);
+		const char* hashed = map_get(names, target);
+		free(target);
+
+		fwrite(at, 1, start - at, file);
+		if (hashed) fputs(hashed, file);
+		else fwrite(start, 1, length, file);
+
+		at = start + length;
+	}
+
+	fwrite(at, 1, end - at, file);
+	fclose(file);
+
+	free(buffer->data);
+	*buffer = *rewritten;
+	free(rewritten);
+}
+
+struct hash_pass {
+	struct map* names;
+	bool css;
+};
+
+static void* hash_static(const char* name, void* buffer, void* user) {
+	struct hash_pass* pass = user;
+	if (is_css(name) != pass->css) return NULL;
+
+	if (pass->css) rewrite_css(pass->names, buffer);
+	map_set(pass->names, name, hashed_name(name, buffer));
+
+	return NULL;
+}
+
+static void hash_statics(struct generator* gen) {
+	gen->static_names = map_new();
+
+	// stylesheets are hashed after everything they could refer to
+	struct hash_pass pass = { gen->static_names, false };
+	map_iter(gen->statics, hash_static, &pass);
+
+	pass.css = true;
+	map_iter(gen->statics, hash_static, &pass);
+}
+
+// templates refer to a static by its name with anything but letters and
+// digits replaced by _, so style.css is $[assets.style_css]
+static void* asset_to_json(const char* name, void* buffer, void* user) {
+	(void) buffer;
+	struct generator* gen = ((void**) user)[0];
+	cJSON* assets = ((void**) user)[1];
+
+	char* key = astrndup(name, strlen(name));
+	for (char* c = key; *c; c++) if (!isalnum((unsigned char) *c)) *c = '_';
+
+	const char* output = gen->static_names
+		? map_get(gen->static_names, name)
+		: name;
+	cJSON_AddStringToObject(assets, key, output);
+	free(key);
+
+	return NULL;
+}
+
+static cJSON* assets_to_json(struct generator* gen) {
+	cJSON* assets = cJSON_CreateObject();
+	map_iter(gen->statics, asset_to_json, (void*[]) { gen, assets });
+	return assets;
+}
+
+// passes a file in the output on to be compressed and listed
+static void wrote_file(
+	struct ctx* ctx,
+	const char* name,
+	const char* data,
+	size_t length
+) {
+	if (ctx->compressor) compressor_add(ctx->compressor, name, data, length);
+	if (ctx->manifest) manifest_add(ctx->manifest, name, data, length);
+}
+
+static int write_file(
+	struct ctx* ctx,
+	const char* name,
+	const char* data,
+	size_t length
+) {
+	if (ctx->sink) return ctx->sink(name, data, length, ctx->sink_user) ? 2 : 0;
+
+	int ret = write_at(ctx->output, name, data, length);
+	if (ret == 0) wrote_file(ctx, name, data, length);
+
+	return ret;
+}
+
+// whether a file in the output already has the contents of a static
+static bool same_contents(int dir_fd, const char* name, struct buffer* buffer) {
+	struct stat st;
+	if (fstatat(dir_fd, name, &st, 0) == -1) return false;
+	if ((size_t) st.st_size != buffer->length) return false;
+
+	int fd = openat(dir_fd, name, O_RDONLY);
+	if (fd == -1) return false;
+
+	char buf[8192];
+	size_t at = 0;
+	ssize_t read_result;
+
+	while ((read_result = read(fd, buf, sizeof(buf))) > 0) {
+		if (
+			at + read_result > buffer->length ||
+			memcmp(buf, buffer->data + at, read_result) != 0
+		) break;
+
+		at += read_result;
+	}
+
+	close(fd);
+	return read_result == 0 && at == buffer->length;
+}
+
+// copies a static from the template to the output within the kernel, as a
+// reflink where the filesystem has them; returns -1 when it could not be
+// copied this way, to be written from memory instead
+static int clone_static(
+	int source_fd,
+	const char* name,
+	int dir_fd,
+	const char* output,
+	size_t length
+) {
+	int in_fd = openat(source_fd, name, O_RDONLY);
+	if (in_fd == -1) return -1;
+
+	// the template may have changed since it was loaded
+	struct stat st;
+	if (fstat(in_fd, &st) == -1 || (size_t) st.st_size != length) {
+		close(in_fd);
+		return -1;
+	}
+
+	int out_fd = create_at(dir_fd, output, true);
+	if (out_fd == -1) {
+		close(in_fd);
+		return -1;
+	}
+
+	int ret = 0;
+
+#ifdef FICLONE
+	if (ioctl(out_fd, FICLONE, in_fd) == 0) goto end;
+#endif
+
+#ifdef SYS_copy_file_range
+	for (size_t copied = 0; copied < length;) {
+		ssize_t result = syscall(
+			SYS_copy_file_range, in_fd, NULL, out_fd, NULL, length - copied, 0
+		);
+
+		if (result <= 0) {
+			ret = -1;
+			break;
+		}
+
+		copied += result;
+	}
+#else
+	ret = -1;
+#endif
+
+end:
+	close(in_fd);
+	close(out_fd);
+
+	if (ret == -1) unlinkat(dir_fd, output, 0);
+
+	return ret;
+}
+
+// hard links a static into the output from the store shared by outputs,
+// adding it to the store first if needed; returns -1 when it could not be
+// linked, to be copied instead
+static int link_static(
+	int store_fd,
+	int dir_fd,
+	const char* output,
+	struct buffer* buffer
+) {
+	// stored files are named by their hash, so they never change once written
+	char* stored = asprintf(
+		"%016" PRIx64 "-%s", hash_bytes(buffer->data, buffer->length, 0), output
+	);
+	int ret = 0;
+
+	if (faccessat(store_fd, stored, F_OK, 0) == -1) {
+		// other outputs may be adding the same file at the same time
+		char* temp = asprintf(
+			".%s.%ld.%lu", stored, (long) getpid(), (unsigned long) pthread_self()
+		);
+
+		ret = write_at(store_fd, temp, buffer->data, buffer->length);
+		if (ret == 0 && renameat(store_fd, temp, store_fd, stored) == -1) {
+			perrorf("failed to add '%s' to the static store", output);
+			ret = 2;
+		}
+
+		if (ret > 0) unlinkat(store_fd, temp, 0);
+		free(temp);
+	}
+
+	if (ret == 0 && linkat(store_fd, stored, dir_fd, output, 0) == -1) {
+		if (errno == EXDEV || errno == EPERM || errno == EMLINK) {
+			ret = -1;
+		} else {
+			perrorf("failed to link '%s' from the static store", output);
+			ret = 2;
+		}
+	}
+
+	free(stored);
+	return ret;
+}
+
+struct static_copy {
+	struct ctx* ctx;
+	int source_fd; /* the template's static dir, or -1 */
+	int store_fd;  /* the static store, or -1 */
+};
+
+static void* write_static(const char* name, void* buffer, void* user) {
+	struct static_copy* copy = user;
+	struct ctx* ctx = copy->ctx;
+	struct buffer* static_file = buffer;
+
+	const char* output = ctx->gen->static_names
+		? map_get(ctx->gen->static_names, name)
+		: name;
+
+	if (ctx->aliases) {
+		char* file = asprintf("%s/static/%s", ctx->gen->templates.dir, name);
+		depend(*ctx, output, file);
+		free(file);
+	}
+
+	if (ctx->sink) {
+		int ret = write_file(ctx, output, static_file->data, static_file->length);
+		return ret ? (void*) name : NULL;
+	}
+
+	// a static already in the output is compared rather than written again, so
+	// that the fonts are not rewritten each run; this holds for hashed names
+	// too, which could be shared by different contents
+	if (!same_contents(ctx->output, output, static_file)) {
+		// the old file may be a link into the store, which must not be written to
+		if (unlinkat(ctx->output, output, 0) == -1 && errno != ENOENT) {
+			perrorf("failed to replace output '%s'", output);
+			return (void*) name;
+		}
+
+		int ret = -1;
+		if (copy->store_fd != -1)
+			ret = link_static(copy->store_fd, ctx->output, output, static_file);
+
+		// stylesheets have their urls rewritten when hashing the statics
+		bool rewritten = ctx->gen->static_names && is_css(name);
+		if (ret == -1 && copy->source_fd != -1 && !rewritten) {
+			ret = clone_static(
+				copy->source_fd, name, ctx->output, output, static_file->length
+			);
+		}
+
+		if (ret == -1) {
+			ret = write_at(
+				ctx->output, output, static_file->data, static_file->length
+			);
+		}
+		if (ret > 0) return (void*) name;
+	}
+
+	wrote_file(ctx, output, static_file->data, static_file->length);
+	return NULL;
+}
+
+// records a static in the manifest when it is not written again
+static void* keep_static(const char* name, void* buffer, void* user) {
+	struct ctx* ctx = user;
+	struct buffer* static_file = buffer;
+
+	const char* output = ctx->gen->static_names
+		? map_get(ctx->gen->static_names, name)
+		: name;
+	manifest_add(ctx->manifest, output, static_file->data, static_file->length);
+
+	return NULL;
+}
+
+// writes a file for another format, creating any directories in its path
+static int write_output(
+	const char* path,
+	const char* data,
+	size_t length,
+	void* user
+) {
+	struct ctx* ctx = user;
+
+	for (const char* slash = path; (slash = strchr(slash, '/')); slash++) {
+		if (ctx->sink) break;
+
+		char* dir = astrndup(path, slash - path);
+		int ret = mkdirat(ctx->output, dir, DIR_FLAGS);
+		free(dir);
+
+		if (ret == -1 && errno != EEXIST) {
+			perrorf("failed to create output dir");
+			return 2;
+		}
+	}
+
+	return write_file(ctx, path, data, length);
+}
+
+static int copy_statics(struct ctx ctx) {
+	struct static_copy copy = { &ctx, -1, -1 };
+
+	if (!ctx.sink) {
+		char* dir = asprintf("%s/static", ctx.gen->templates.dir);
+		copy.source_fd = open(dir, O_RDONLY | O_DIRECTORY);
+		free(dir);
+	}
+
+	const char* store = ctx.opts->static_store;
+	if (store && !ctx.sink) {
+		if (mkdir(store, DIR_FLAGS) == -1 && errno != EEXIST) {
+			perrorf("failed to create static store");
+			if (copy.source_fd != -1) close(copy.source_fd);
+			return 2;
+		}
+
+		if ((copy.store_fd = open(store, O_RDONLY | O_DIRECTORY)) == -1) {
+			perrorf("failed to open static store");
+			if (copy.source_fd != -1) close(copy.source_fd);
+			return 2;
+		}
+	}
+
+	int ret = map_iter(ctx.gen->statics, write_static, &copy) ? 2 : 0;
+
+	if (copy.source_fd != -1) close(copy.source_fd);
+	if (copy.store_fd != -1) close(copy.store_fd);
+
+	return ret;
+}
+
+static bool check_template(const char* path) {
+	DIR* dir = opendir(path);
+	if (!dir) return false;
+	closedir(dir);
+	return true;
+}
+
+static char* default_template() {
+	const char* dirs;
+	if ((dirs = getenv("XDG_DATA_DIRS"))) {
+		do {
+			int length = strcspn(dirs, ":");
+
+			char* test = asprintf("%.*s/" NAME "/template", length, dirs);
+			if (check_template(test)) return test;
+			free(test);
+
+			dirs += length + 1;
+		} while (dirs[-1]);
+	}
+
+	if (check_template("/usr/share/" NAME "/template"))
+		return asprintf("/usr/share/" NAME "/template");
+	if (check_template("/usr/share/local/" NAME "/template"))
+		return asprintf("/usr/share/local/" NAME "/template");
+
+	return NULL;
+}
+
+// copies a lattice expression like $[...] from in to out, where in is at its
+// opening bracket, reducing any whitespace outside of strings to a space;
+// returns the end of the expression
+static const char* copy_expression(char** out, const char* in) {
+	int depth = 0;
+
+	while (*in) {
+		if (*in == '"' || *in == '\'') {
+			char quote = *in;
+			*(*out)++ = *in++;
+
+			for (; *in && *in != quote; in++) {
+				if (*in == '\\' && in[1]) *(*out)++ = *in++;
+				*(*out)++ = *in;
+			}
+
+			if (*in) *(*out)++ = *in++;
+		} else if (isspace((unsigned char) *in)) {
+			while (isspace((unsigned char) *in)) in++;
+			*(*out)++ = ' ';
+		} else {
+			if (*in == '[' || *in == '{' || *in == '(') depth++;
+			if (*in == ']' || *in == '}' || *in == ')') depth--;
+
+			*(*out)++ = *in++;
+			if (depth == 0) break;
+		}
+	}
+
+	return in;
+}
+
+// returns the end of an element whose contents must be left alone, or NULL if
+// at is not the start of one
+static const char* skip_raw_element(const char* at) {
+	static const char* names[] = { "pre", "script", "style", "textarea" };
+
+	if (*at != '<') return NULL;
+
+	for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+		size_t length = strlen(names[i]);
+		if (strncmp(at + 1, names[i], length)) continue;
+		if (at[length + 1] != '>' && !isspace((unsigned char) at[length + 1]))
+			continue;
+
+		char close[length + 4];
+		sprintf(close, "</%s>", names[i]);
+
+		const char* end = strstr(at, close);
+		return end ? end + length + 3 : at + strlen(at);
+	}
+
+	return NULL;
+}
+
+// strips comments and indentation from the html of a template, in place, so
+// that it is done once rather than for every page; the contents of pre,
+// script, style and textarea elements and of strings in lattice expressions
+// are kept as they are, and other whitespace is kept as a newline or as it is
+static void minify_template(char* text) {
+	char* out = text;
+	const char* in = text;
+
+	while (*in) {
+		const char* end = NULL;
+
+		if (in[0] == '$' && (in[1] == '[' || in[1] == '{' || in[1] == '(')) {
+			*out++ = *in++;
+			in = copy_expression(&out, in);
+			continue;
+		}
+
+		if ((end = skip_raw_element(in))) {
+			memmove(out, in, end - in);
+			out += end - in;
+			in = end;
+			continue;
+		}
+
+		if (strncmp(in, "<!--", 4) == 0 && (end = strstr(in + 4, "-->"))) {
+			in = end + 3;
+			continue;
+		}
+
+		if (isspace((unsigned char) *in)) {
+			const char* start = in;
+			bool newline = false;
+
+			for (; isspace((unsigned char) *in); in++)
+				if (*in == '\n') newline = true;
+
+			if (newline) {
+				if (out != text) *out++ = '\n';
+			} else {
+				memmove(out, start, in - start);
+				out += in - start;
+			}
+
+			continue;
+		}
+
+		*out++ = *in++;
+	}
+
+	*out = 0;
+}
+
+static char* load_template(struct generator* gen, const char* name) {
+	char* filename = asprintf("%s/pages/%s.html", gen->templates.dir, name);
+	char* contents = read_file(filename);
+	free(filename);
+
+	if (contents && gen->opts.minify) minify_template(contents);
+
+	return contents;
+}
+
+static void* filter_module_name(void* module, void* name) {
+	return strcmp(((struct module*) module)->name, name) == 0 ? module : NULL;
+}
+
+static void* filter_item_name(void* item, void* name) {
+	return strcmp(((struct item*) item)->name, name) == 0 ? item : NULL;
+}
+
+static int make_dir(struct ctx ctx, const char* name) {
+	if (ctx.sink) return 0;
+
+	char* path = asprintf("%s%s", ctx.path, name);
+	int ret = mkdirat(ctx.output, path, DIR_FLAGS);
+	free(path);
+
+	if (ret == -1 && errno != EEXIST) {
+		perrorf("failed to create output dir");
+		return 2;
+	}
+
+	return 0;
+}
+
+static void free_depends(struct map* files) {
+	map_free(files, NULL);
+}
+
+static void depend(struct ctx ctx, const char* path, const char* file) {
+	if (ctx.aliases == NULL || file == NULL) return;
+
+	pthread_mutex_lock(&ctx.gen->lock);
+
+	struct map* files = map_get(ctx.gen->depends, path);
+	if (files == NULL) {
+		files = map_new();
+		map_set(ctx.gen->depends, path, files);
+	}
+
+	map_set(files, file, (void*) file);
+
+	pthread_mutex_unlock(&ctx.gen->lock);
+}
+
+struct depend_all {
+	struct ctx* ctx;
+	const char* path;
+};
+
+static void* depend_source(const char* alias, void* file, void* user) {
+	struct depend_all* all = user;
+	depend(*all->ctx, all->path, file);
+
+	return NULL;
+}
+
+// a page depends on its template, and on the sources in ctx.deps
+static void depend_page(
+	struct ctx ctx,
+	const char* path,
+	const char* template
+) {
+	if (ctx.aliases == NULL) return;
+
+	struct templates* templates = &ctx.gen->templates;
+	const char* name =
+		template == templates->item ? "item" :
+		template == templates->list ? "list" :
+		template == templates->module ? "module" :
+		template == templates->app ? "app" : "source";
+
+	char* file = asprintf("%s/pages/%s.html", templates->dir, name);
+	depend(ctx, path, file);
+	free(file);
+
+	if (ctx.deps == NULL) {
+		struct depend_all all = { &ctx, path };
+		map_iter(ctx.aliases, depend_source, &all);
+	} else {
+		LIST_ITER_T(ctx.deps, alias, const char*)
+			if (alias) depend(ctx, path, map_get(ctx.aliases, alias));
+	}
+}
+
+static void write_escaped(FILE* file, const char* path) {
+	for (; *path; path++) {
+		if (*path == ' ' || *path == '#') fputc('\\', file);
+		if (*path == '$') fputc('$', file);
+
+		fputc(*path, file);
+	}
+}
+
+static void write_rule(
+	FILE* file,
+	const char* output,
+	const char* path,
+	struct list* files
+) {
+	write_escaped(file, output);
+	fputc('/', file);
+	write_escaped(file, path);
+	fputc(':', file);
+
+	LIST_ITER_T(files, dep, const char*) {
+		fputs(" \\\n  ", file);
+		write_escaped(file, dep);
+	}
+
+	fputs("\n", file);
+}
+
+static void* collect_key(const char* key, void* value, void* list) {
+	list_push(list, (void*) key);
+	return NULL;
+}
+
+static int compare_strings(const void* a, const void* b) {
+	return strcmp(*(const char**) a, *(const char**) b);
+}
+
+// writes a makefile fragment with a rule for each output file, listing the
+// sources and template files it was generated from
+static int write_depfile(struct generator* gen, const char* output) {
+	char* data;
+	size_t length;
+	FILE* file = open_memstream(&data, &length);
+	if (file == NULL) {
+		perrorf("failed to write '%s'", gen->opts.depfile);
+		return 3;
+	}
+
+	struct list* paths = list_new();
+	map_iter(gen->depends, collect_key, paths);
+	list_sort(paths, compare_strings);
+
+	LIST_ITER_T(paths, path, const char*) {
+		struct list* files = list_new();
+		map_iter(map_get(gen->depends, path), collect_key, files);
+		list_sort(files, compare_strings);
+
+		write_rule(file, output, path, files);
+		list_free(files, NULL);
+	}
+
+	list_free(paths, NULL);
+	fclose(file);
+
+	int ret = write_at(AT_FDCWD, gen->opts.depfile, data, length);
+	free(data);
+
+	return ret;
+}
+
+static int render_template(
+	struct ctx ctx,
+	const char* template,
+	cJSON* json,
+	FILE* file,
+	const char* what
+) {
+	// every page can refer to the statics by the names they are written as
+	if (!cJSON_GetObjectItem(json, "assets"))
+		cJSON_AddItemReferenceToObject(json, "assets", ctx.gen->assets);
+
+	lattice_error *err = NULL;
+	const char *search[] = { ctx.gen->templates.dir, NULL };
+	lattice_opts opts = { .search = search, .ignore_emit_zero = true };
+	lattice_cjson_file(template, json, file, opts, &err);
+
+	if (err) {
+		perrorf("failed to render %s template (%s)", what, err->message);
+
+		lattice_error_code code = err->code;
+		lattice_error_free(err);
+		return code == LATTICE_IO_ERROR ? 2 : 3;
+	}
+
+	return 0;
+}
+
+static int render_page(
+	struct ctx ctx,
+	const char* name,
+	const char* template,
+	cJSON* json,
+	const char* what
+) {
+	char* path = asprintf("%s%s", ctx.path, name);
+	depend_page(ctx, path, template);
+
+	if (ctx.sink) {
+		struct buffer* buffer = render_buffer(ctx, template, json, what);
+		if (buffer == NULL) {
+			free(path);
+			return 3;
+		}
+
+		int ret = ctx.sink(path, buffer->data, buffer->length, ctx.sink_user);
+		buffer_free(buffer);
+		free(path);
+
+		return ret ? 2 : 0;
+	}
+
+	// when running incrementally, the page is only rendered again if its input
+	// has changed since the last time (templates are accounted for on reload)
+	uint64_t* hash = NULL;
+	if (ctx.gen->pages) {
+		char* printed = cJSON_PrintUnformatted(json);
+		uint64_t current = hash_string(printed);
+		free(printed);
+
+		hash = map_get(ctx.gen->pages, path);
+		if (
+			hash && *hash == current &&
+			faccessat(ctx.output, path, F_OK, 0) == 0
+		) {
+			if (ctx.manifest) manifest_keep(ctx.manifest, path);
+			free(path);
+			return 0;
+		}
+
+		if (!hash) {
+			hash = malloc(sizeof(uint64_t));
+			map_set(ctx.gen->pages, path, hash);
+		}
+
+		*hash = current;
+	}
+
+	// the page is only held in memory when it is also to be compressed or hashed
+	if (ctx.compressor || ctx.manifest) {
+		struct buffer* buffer = render_buffer(ctx, template, json, what);
+		int ret = buffer
+			? write_file(&ctx, path, buffer->data, buffer->length)
+			: 3;
+
+		if (buffer) buffer_free(buffer);
+		free(path);
+
+		if (ret > 0 && hash) *hash = 0;
+
+		return ret;
+	}
+
+	int fd = create_at(ctx.output, path, false);
+	free(path);
+
+	if (fd == -1) {
+		perrorf("failed to open output");
+		return 2;
+	}
+
+	FILE *file = fdopen(fd, "w");
+	if (!file) {
+		perrorf("failed to open output");
+		return 2;
+	}
+
+	int ret = render_template(ctx, template, json, file, what);
+	fclose(file);
+
+	// make sure a failed page is rendered again next time
+	if (ret > 0 && hash) *hash = 0;
+
+	return ret;
+}
+
+static char* render_desc(struct ctx ctx, const char* raw) {
+	struct generator* memo_gen = ctx.gen->memo;
+
+	if (memo_gen->markdown) {
+		pthread_mutex_lock(&memo_gen->lock);
+
+		const char* memo = map_get(memo_gen->markdown, raw);
+		char* desc = memo ? astrndup(memo, strlen(memo)) : NULL;
+
+		pthread_mutex_unlock(&memo_gen->lock);
+
+		if (desc) return desc;
+	}
+
+	char* desc;
+	if (ctx.opts->no_markdown) {
+		size_t allocate = 12;
+		for (const char *ch = raw; *ch; ch++)
+			allocate += (*ch == '<' || *ch == '>' || *ch == '&') ? 5 : 1;
+
+		desc = malloc(allocate);
+		strcpy(desc, "<pre>");
+
+		for (size_t i = 0, j = 5; raw[i]; i++, j++) {
+			char ch = raw[i];
+			desc[j] = ch;
+
+			if (ch == '<' || ch == '>' || ch == '&') {
+				sprintf(desc + j, "&#%02d;", raw[i]);
+				j += 4;
+			}
+		}
+
+		strcpy(desc + allocate - 7, "</pre>");
+	} else {
+		desc = cmark_markdown_to_html(raw, strlen(raw), 0);
+	}
+
+	if (memo_gen->markdown) {
+		pthread_mutex_lock(&memo_gen->lock);
+
+		char* old = map_set(memo_gen->markdown, raw, astrndup(desc, strlen(desc)));
+		free(old);
+
+		pthread_mutex_unlock(&memo_gen->lock);
+	}
+
+	return desc;
+}
+
+char* generator_markdown(struct generator* gen, const char* raw) {
+	struct ctx ctx = { .gen = gen, .opts = &gen->opts };
+	return render_desc(ctx, raw);
+}
+
+// the entry for an item on the page of its parent, which also has all of the
+// item itself when it is a section of that page
+static cJSON* member_to_json(struct ctx ctx, struct item* item) {
+	cJSON* nd = cJSON_CreateObject();
+
+	cJSON_AddStringToObject(nd, "name", item->name);
+	cJSON_AddStringToObject(nd, "desc", item->desc);
+
+	bool section = ctx.opts->aggregate || ctx.opts->spa;
+	if (!section || item->type == ITEM_CLASS) return nd;
+
+	char* body = item->desc ? render_desc(ctx, item->desc) : NULL;
+	cJSON_AddStringToObject(nd, "body", body ? body : "");
+	cJSON_AddStringToObject(nd, "rawDesc", item->desc ? item->desc : "");
+	free(body);
+
+	if (item->filename) {
+		cJSON* source = cJSON_AddObjectToObject(nd, "source");
+
+		cJSON_AddStringToObject(source, "file", item->filename);
+		cJSON_AddNumberToObject(source, "line", (double) item->line);
+	} else {
+		cJSON_AddNullToObject(nd, "source");
+	}
+
+	if (item->type == ITEM_FUNC) {
+		cJSON *params = cJSON_AddArrayToObject(nd, "params");
+
+		LIST_ITER_T(item->items, param, struct param*) {
+			cJSON *param_nd = cJSON_CreateObject();
+
+			cJSON_AddStringToObject(param_nd, "name", param->name);
+			cJSON_AddBoolToObject(param_nd, "optional", param->optional);
+			cJSON_AddBoolToObject(param_nd, "variable", param->variable);
+
+			cJSON_AddItemToArray(params, param_nd);
+		}
+	}
+
+	return nd;
+}
+
+static cJSON* module_to_json(struct ctx ctx, struct module* module) {
+	struct list* stack = ctx.stack;
+
+	char crumbs[list_length(stack) * 3 + 1];
+
+	crumbs[0] = 0;
+	for (int i = 0; i < list_length(stack); i++) strcpy(crumbs + i * 3, "../");
+
+	cJSON* root = cJSON_CreateObject();
+
+	cJSON_AddStringToObject(root, "name", module->name);
+	cJSON_AddStringToObject(root, "root", crumbs);
+	cJSON_AddStringToObject(root, "library", ctx.opts->library);
+	cJSON_AddStringToObject(root, "generated", ctx.gen->generated);
+	cJSON_AddBoolToObject(root, "aggregate", ctx.opts->aggregate);
+
+	if (module->desc != NULL) {
+		char* desc = render_desc(ctx, module->desc);
+
+		cJSON_AddStringToObject(root, "desc", desc);
+		cJSON_AddStringToObject(root, "rawDesc", module->desc);
+
+		free(desc);
+	} else {
+		cJSON_AddStringToObject(root, "desc", "");
+		cJSON_AddStringToObject(root, "rawDesc", "");
+	}
+
+	cJSON* parents = cJSON_AddArrayToObject(root, "parents");
+	LIST_ITER_T(stack, ancestor, const char*)
+		cJSON_AddItemToArray(parents, cJSON_CreateString(ancestor));
+
+	if (module->filename) {
+		cJSON* source = cJSON_AddObjectToObject(root, "source");
+
+		cJSON_AddStringToObject(source, "file", module->filename);
+		cJSON_AddNumberToObject(source, "line", (double) module->line);
+	} else {
+		cJSON_AddNullToObject(root, "source");
+	}
+
+	cJSON* children = cJSON_AddArrayToObject(root, "modules");
+	cJSON* items[3] = {
+		cJSON_AddArrayToObject(root, "vars"),
+		cJSON_AddArrayToObject(root, "funcs"),
+		cJSON_AddArrayToObject(root, "classes"),
+	};
+
+	LIST_ITER_T(module->children, child, struct module*) {
+		cJSON* nd = cJSON_CreateObject();
+
+		cJSON_AddStringToObject(nd, "name", child->name);
+		cJSON_AddStringToObject(nd, "desc", child->desc ? child->desc : "");
+
+		cJSON_AddItemToArray(children, nd);
+	}
+
+	LIST_ITER_T(module->items, item, struct item*)
+		cJSON_AddItemToArray(items[item->type], member_to_json(ctx, item));
+
+	static const char* keys[4] = { "modules", "vars", "funcs", "classes" };
+	for (int i = 0; i < 4; i++)
+		if (cJSON_GetArraySize(cJSON_GetObjectItem(root, keys[i])) == 0)
+			cJSON_ReplaceItemInObject(root, keys[i], cJSON_CreateNull());
+
+	return root;
+}
+
+static int document_module(struct ctx ctx, struct module* module) {
+	// the page has the names and descriptions of the children and items
+	if (ctx.aliases) {
+		ctx.deps = list_new();
+		list_push(ctx.deps, (void*) module->filename);
+		LIST_ITER_T(module->children, child, struct module*)
+			list_push(ctx.deps, (void*) child->filename);
+		LIST_ITER_T(module->items, item, struct item*)
+			list_push(ctx.deps, (void*) item->filename);
+	}
+
+	cJSON* json = module_to_json(ctx, module);
+	int ret = render_page(
+		ctx, "index.html", ctx.gen->templates.module, json, "module"
+	);
+	cJSON_Delete(json);
+
+	list_free(ctx.deps, NULL);
+	ctx.deps = NULL;
+
+	if (ret > 0) return ret;
+
+	const char* path = ctx.path;
+	list_push(ctx.stack, module->name);
+
+	LIST_ITER_T(module->items, item, struct item*) {
+		int ret = document_item(ctx, item);
+		if (ret > 0) return ret;
+	}
+
+	LIST_ITER_T(module->children, child, struct module*) {
+		if (make_dir(ctx, child->name) > 0) return 2;
+
+		ctx.path = asprintf("%s%s/", path, child->name);
+		int ret = document_module(ctx, child);
+		free((char*) ctx.path);
+		if (ret > 0) return ret;
+	}
+
+	ctx.path = path;
+	list_pop(ctx.stack);
+
+	return 0;
+}
+
+static cJSON* item_to_json(struct ctx ctx, struct item* item) {
+	struct list* stack = ctx.stack;
+
+	int crumb_limit = list_length(stack) - (item->type != ITEM_CLASS);
+	char crumbs[crumb_limit * 3 + 1];
+
+	crumbs[0] = 0;
+	for (int i = 0; i < crumb_limit; i++) strcpy(crumbs + i * 3, "../");
+
+	cJSON* root = cJSON_CreateObject();
+
+	cJSON_AddStringToObject(root, "name", item->name);
+	cJSON_AddStringToObject(root, "root", crumbs);
+	cJSON_AddStringToObject(root, "library", ctx.opts->library);
+	cJSON_AddStringToObject(root, "generated", ctx.gen->generated);
+	cJSON_AddBoolToObject(root, "aggregate", ctx.opts->aggregate);
+
+	static const char* types[] = { "var", "func", "class" };
+	cJSON_AddStringToObject(root, "type", types[item->type]);
+
+	if (item->desc != NULL) {
+		char* desc = render_desc(ctx, item->desc);
+
+		cJSON_AddStringToObject(root, "desc", desc);
+		cJSON_AddStringToObject(root, "rawDesc", item->desc);
+
+		free(desc);
+	} else {
+		cJSON_AddStringToObject(root, "desc", "");
+		cJSON_AddStringToObject(root, "rawDesc", "");
+	}
+
+	cJSON* parents = cJSON_AddArrayToObject(root, "parents");
+	LIST_ITER_T(stack, ancestor, const char*)
+		cJSON_AddItemToArray(parents, cJSON_CreateString(ancestor));
 
 	if (item->filename) {
 		cJSON* source = cJSON_AddObjectToObject(root, "source");
@@ -434,32 +1753,23 @@ static cJSON* item_to_json(
 			cJSON_AddArrayToObject(root, "classes"),
 		};
 
-		LIST_ITER_T(item->items, child, struct item*) {
-			cJSON* nd = cJSON_CreateObject();
-
-			cJSON_AddStringToObject(nd, "name", child->name);
-			cJSON_AddStringToObject(nd, "desc", child->desc);
-
-			cJSON_AddItemToArray(items[child->type], nd);
-		}
+		LIST_ITER_T(item->items, child, struct item*)
+			cJSON_AddItemToArray(items[child->type], member_to_json(ctx, child));
 	}
 
 	return root;
 }
 
 static int document_item(struct ctx ctx, struct item* item) {
-	DIR* dir = ctx.output;
+	// vars and funcs are on the page of their parent instead
+	if (ctx.opts->aggregate && item->type != ITEM_CLASS) return 0;
+
+	const char* path = ctx.path;
 
 	if (item->type == ITEM_CLASS) {
-		if (mkdirat(dirfd(dir), item->name, DIR_FLAGS) == -1) {
-			if (errno != EEXIST) {
-				perrorf("failed to create output dir");
-				return 2;
-			}
-		}
+		if (make_dir(ctx, item->name) > 0) return 2;
 
-		int fd = openat(dirfd(dir), item->name, O_DIRECTORY);
-		ctx.output = fdopendir(fd);
+		ctx.path = asprintf("%s%s/", path, item->name);
 	}
 
 	char filename[11 + strlen(item->name)];
@@ -471,155 +1781,666 @@ static int document_item(struct ctx ctx, struct item* item) {
 		strcat(filename, ".html");
 	}
 
-	int fd = openat(
-		dirfd(ctx.output), filename, O_CREAT | O_WRONLY | O_TRUNC, FILE_FLAGS
-	);
-	if (fd == -1) {
-		perrorf("failed to open output");
-		return 2;
+	if (ctx.aliases) {
+		ctx.deps = list_new();
+		list_push(ctx.deps, (void*) item->filename);
+
+		if (ctx.opts->aggregate && item->type == ITEM_CLASS) {
+			LIST_ITER_T(item->items, child, struct item*)
+				list_push(ctx.deps, (void*) child->filename);
+		}
 	}
 
-	FILE *file = fdopen(fd, "w");
-	if (!file) {
-		perrorf("failed to open output");
-		return 2;
+	cJSON* json = item_to_json(ctx, item);
+	int ret = render_page(ctx, filename, ctx.gen->templates.item, json, "item");
+	cJSON_Delete(json);
+
+	list_free(ctx.deps, NULL);
+	ctx.deps = NULL;
+
+	if (ret == 0 && item->type == ITEM_CLASS) {
+		list_push(ctx.stack, item->name);
+
+		LIST_ITER_T(item->items, child, struct item *) {
+			if ((ret = document_item(ctx, child)) > 0) break;
+		}
+
+		list_pop(ctx.stack);
 	}
 
-	cJSON* json = item_to_json(item, ctx.stack, ctx.opts);
+	if (item->type == ITEM_CLASS) free((char*) ctx.path);
 
-	lattice_error *err = NULL;
-	const char *search[] = { ctx.templates.dir, NULL };
-	lattice_opts opts = { .search = search, .ignore_emit_zero = true };
-	lattice_cjson_file(ctx.templates.item, json, file, opts, &err);
+	return ret;
+}
 
-	fclose(file);
+// documents only the page of a module or class, with ctx already set up for
+// the things in it
+static int document_parent(
+	struct ctx ctx,
+	struct module* module,
+	struct item* class
+) {
+	const char* name = list_pop(ctx.stack);
+
+	if (ctx.aliases) {
+		ctx.deps = list_new();
+		list_push(ctx.deps, (void*) (class ? class->filename : module->filename));
+		LIST_ITER_T(class ? class->items : module->items, item, struct item*)
+			list_push(ctx.deps, (void*) item->filename);
+	}
+
+	cJSON* json = class ? item_to_json(ctx, class) : module_to_json(ctx, module);
+	int ret = class
+		? render_page(ctx, "index.html", ctx.gen->templates.item, json, "item")
+		: render_page(
+			ctx, "index.html", ctx.gen->templates.module, json, "module"
+		);
 	cJSON_Delete(json);
 
-	if (err) {
-		fprintf(stderr, "%s %d\n", item->name, err->line);
-		perrorf("failed to render item template (%s)", err->message);
+	list_free(ctx.deps, NULL);
+	list_push(ctx.stack, (void*) name);
 
-		lattice_error_code code = err->code;
-		lattice_error_free(err);
-		return code == LATTICE_IO_ERROR ? 2 : 3;
+	return ret;
+}
+
+// documents only the module or item at selector (a dot-separated path from the
+// root), creating the directories above it as necessary
+static int document_selected(
+	struct ctx ctx,
+	struct module* root,
+	const char* selector
+) {
+	const char* segment = selector + (selector[0] == '.');
+	if (segment[0] == 0) return document_module(ctx, root);
+
+	struct module* module = root;
+	struct item* class = NULL;
+	char* path = astrndup("", 0);
+	int ret = 0;
+
+	list_push(ctx.stack, root->name);
+
+	while (true) {
+		size_t length = strcspn(segment, ".");
+		char name[length + 1];
+		strncpy(name, segment, length);
+		name[length] = 0;
+
+		struct module* child = NULL;
+		struct item* item = NULL;
+
+		if (class == NULL)
+			child = list_iter(module->children, filter_module_name, name);
+		if (child == NULL)
+			item = list_iter(
+				class ? class->items : module->items, filter_item_name, name
+			);
+
+		if (
+			(child == NULL && item == NULL) ||
+			(segment[length] && item && item->type != ITEM_CLASS)
+		) {
+			errorf("'%s' does not match any module or item\n", selector);
+			ret = 3;
+			break;
+		}
+
+		ctx.path = path;
+
+		if (segment[length] == 0) {
+			if (child) {
+				if ((ret = make_dir(ctx, child->name)) > 0) break;
+
+				ctx.path = asprintf("%s%s/", path, child->name);
+				ret = document_module(ctx, child);
+				free((char*) ctx.path);
+			} else if (ctx.opts->aggregate && item->type != ITEM_CLASS) {
+				ret = document_parent(ctx, module, class);
+			} else {
+				ret = document_item(ctx, item);
+			}
+
+			break;
+		}
+
+		if ((ret = make_dir(ctx, name)) > 0) break;
+
+		char* next = asprintf("%s%s/", path, name);
+		free(path);
+		path = next;
+
+		if (child) module = child;
+		else class = item;
+
+		list_push(ctx.stack, child ? child->name : item->name);
+		segment += length + 1;
 	}
 
-	if (item->type == ITEM_CLASS) {
-		list_push(ctx.stack, item->name);
+	while (list_length(ctx.stack) > 0) list_pop(ctx.stack);
+	free(path);
 
-		LIST_ITER_T(item->items, child, struct item *) {
-			int ret = document_item(ctx, child);
-			if (ret > 0) return ret;
+	return ret;
+}
+
+static const char* type_keys[] = {
+	[ITEM_VAR] = "vars",
+	[ITEM_FUNC] = "funcs",
+	[ITEM_CLASS] = "classes",
+};
+
+static void all_class_to_json(
+	cJSON *root,
+	struct item *class,
+	struct list *stack
+) {
+	list_push(stack, class->name);
+
+	LIST_ITER_T(class->items, item, struct item *) {
+		cJSON *array = cJSON_GetObjectItem(root, type_keys[item->type]);
+		cJSON *entry = cJSON_CreateArray();
+
+		LIST_ITER_T(stack, parent, const char *) {
+			cJSON_AddItemToArray(entry, cJSON_CreateString(parent));
+		}
+		cJSON_AddItemToArray(entry, cJSON_CreateString(item->name));
+
+		cJSON_AddItemToArray(array, entry);
+
+		if (item->type == ITEM_CLASS) all_class_to_json(root, item, stack);
+	}
+
+	list_pop(stack);
+}
+
+static void all_to_json(
+	cJSON *root,
+	struct module *module,
+	struct list *stack
+) {
+	list_push(stack, module->name);
+
+	LIST_ITER_T(module->items, item, struct item *) {
+		cJSON *array = cJSON_GetObjectItem(root, type_keys[item->type]);
+		cJSON *entry = cJSON_CreateArray();
+
+		LIST_ITER_T(stack, parent, const char *) {
+			cJSON_AddItemToArray(entry, cJSON_CreateString(parent));
+		}
+		cJSON_AddItemToArray(entry, cJSON_CreateString(item->name));
+
+		cJSON_AddItemToArray(array, entry);
+
+		if (item->type == ITEM_CLASS) all_class_to_json(root, item, stack);
+	}
+
+	LIST_ITER_T(module->children, child, struct module *) {
+		all_to_json(root, child, stack);
+	}
+
+	list_pop(stack);
+}
+
+/*
+	with spa, the html is one shell page which renders the data of each module
+	and class, fetched when it is shown; the data of the module or class at a
+	path is at data/root.PATH.json (data/root.json for the root), and is the
+	json its page would have, with each var and func as a section of it
+*/
+
+static int write_data(
+	struct ctx ctx,
+	const char* path,
+	cJSON* json,
+	const char* filename,
+	struct list* items
+) {
+	char* data = cJSON_PrintUnformatted(json);
+	if (data == NULL) {
+		errorf("failed to serialise the data of '%s'\n", path);
+		return 3;
+	}
+
+	char* name = *path
+		? asprintf("data/root.%s.json", path)
+		: asprintf("data/root.json");
+
+	if (ctx.aliases) {
+		if (filename) depend(ctx, name, map_get(ctx.aliases, filename));
+
+		LIST_ITER_T(items, item, struct item*)
+			if (item->filename)
+				depend(ctx, name, map_get(ctx.aliases, item->filename));
+	}
+
+	int ret = write_output(name, data, strlen(data), &ctx);
+
+	free(name);
+	free(data);
+
+	return ret;
+}
+
+static int document_class_data(
+	struct ctx ctx,
+	struct item* class,
+	const char* path
+) {
+	cJSON* json = item_to_json(ctx, class);
+	int ret = write_data(ctx, path, json, class->filename, class->items);
+	cJSON_Delete(json);
+
+	if (ret > 0) return ret;
+
+	list_push(ctx.stack, class->name);
+
+	LIST_ITER_T(class->items, item, struct item*) {
+		if (item->type != ITEM_CLASS) continue;
+
+		char* item_path = asprintf("%s.%s", path, item->name);
+		ret = document_class_data(ctx, item, item_path);
+		free(item_path);
+
+		if (ret > 0) break;
+	}
+
+	list_pop(ctx.stack);
+
+	return ret;
+}
+
+static int document_module_data(
+	struct ctx ctx,
+	struct module* module,
+	const char* path
+) {
+	cJSON* json = module_to_json(ctx, module);
+	int ret = write_data(ctx, path, json, module->filename, module->items);
+	cJSON_Delete(json);
+
+	if (ret > 0) return ret;
+
+	list_push(ctx.stack, module->name);
+
+	LIST_ITER_T(module->items, item, struct item*) {
+		if (item->type != ITEM_CLASS) continue;
+
+		char* item_path = *path
+			? asprintf("%s.%s", path, item->name)
+			: asprintf("%s", item->name);
+		ret = document_class_data(ctx, item, item_path);
+		free(item_path);
+
+		if (ret > 0) break;
+	}
+
+	LIST_ITER_T(module->children, child, struct module*) {
+		if (ret > 0) break;
+
+		char* child_path = *path
+			? asprintf("%s.%s", path, child->name)
+			: asprintf("%s", child->name);
+		ret = document_module_data(ctx, child, child_path);
+		free(child_path);
+	}
+
+	list_pop(ctx.stack);
+
+	return ret;
+}
+
+static int document_app(struct ctx ctx, struct module* root) {
+	cJSON* json = cJSON_CreateObject();
+	cJSON_AddStringToObject(json, "root", "./");
+	cJSON_AddStringToObject(json, "library", ctx.opts->library);
+	cJSON_AddStringToObject(json, "generated", ctx.gen->generated);
+	cJSON_AddBoolToObject(json, "aggregate", ctx.opts->aggregate);
+
+	int ret = render_page(ctx, "index.html", ctx.gen->templates.app, json, "app");
+	cJSON_Delete(json);
+
+	if (ret == 0) ret = document_module_data(ctx, root, "");
+	if (ret == 0) ret = document_search(ctx, root);
+
+	return ret;
+}
+
+// adds a group for the items directly in a container, holding its path once
+// for all of them, then one for each class in it
+static void group_to_json(
+	cJSON* groups,
+	struct list* items,
+	struct list* stack
+) {
+	if (list_length(items) == 0) return;
+
+	cJSON* group = cJSON_CreateObject();
+
+	cJSON* parents = cJSON_AddArrayToObject(group, "parents");
+	LIST_ITER_T(stack, parent, const char*)
+		cJSON_AddItemToArray(parents, cJSON_CreateString(parent));
+
+	cJSON* names[3] = {
+		cJSON_AddArrayToObject(group, "vars"),
+		cJSON_AddArrayToObject(group, "funcs"),
+		cJSON_AddArrayToObject(group, "classes"),
+	};
+
+	LIST_ITER_T(items, item, struct item*)
+		cJSON_AddItemToArray(names[item->type], cJSON_CreateString(item->name));
+
+	cJSON_AddItemToArray(groups, group);
+
+	LIST_ITER_T(items, item, struct item*) {
+		if (item->type != ITEM_CLASS) continue;
+
+		list_push(stack, item->name);
+		group_to_json(groups, item->items, stack);
+		list_pop(stack);
+	}
+}
+
+static void module_groups_to_json(
+	cJSON* groups,
+	struct module* module,
+	struct list* stack
+) {
+	list_push(stack, module->name);
+
+	group_to_json(groups, module->items, stack);
+
+	LIST_ITER_T(module->children, child, struct module*)
+		module_groups_to_json(groups, child, stack);
+
+	list_pop(stack);
+}
+
+// the json of list.html, or when it is sharded, of the index (with a NULL
+// shard) or the shard for one top-level module
+static cJSON* list_to_json(
+	struct ctx ctx,
+	struct module* root,
+	struct module* shard
+) {
+	cJSON *json = cJSON_CreateObject();
+	cJSON_AddStringToObject(json, "root", "./");
+	cJSON_AddStringToObject(json, "library", ctx.opts->library);
+	cJSON_AddStringToObject(json, "generated", ctx.gen->generated);
+	cJSON_AddBoolToObject(json, "aggregate", ctx.opts->aggregate);
+
+	struct list *stack = list_new();
+
+	if (ctx.opts->shard_list) {
+		cJSON* groups = cJSON_AddArrayToObject(json, "groups");
+
+		if (shard) {
+			cJSON_AddStringToObject(json, "shard", shard->name);
+
+			list_push(stack, root->name);
+			module_groups_to_json(groups, shard, stack);
+		} else {
+			cJSON_AddNullToObject(json, "shard");
+
+			cJSON* shards = cJSON_AddArrayToObject(json, "shards");
+			LIST_ITER_T(root->children, child, struct module*)
+				cJSON_AddItemToArray(shards, cJSON_CreateString(child->name));
+
+			list_push(stack, root->name);
+			group_to_json(groups, root->items, stack);
 		}
+	} else {
+		cJSON_AddArrayToObject(json, "vars");
+		cJSON_AddArrayToObject(json, "funcs");
+		cJSON_AddArrayToObject(json, "classes");
+
+		all_to_json(json, root, stack);
+	}
+
+	list_free(stack, NULL);
+
+	return json;
+}
+
+static int document_list(struct ctx ctx, struct module* root) {
+	cJSON* json = list_to_json(ctx, root, NULL);
+	int ret = render_page(
+		ctx, "list.html", ctx.gen->templates.list, json, "list"
+	);
+	cJSON_Delete(json);
+
+	if (ret > 0) return ret;
+	if (!ctx.opts->shard_list) return document_search(ctx, root);
+
+	// only one shard is held at a time
+	LIST_ITER_T(root->children, child, struct module*) {
+		char* name = asprintf("list.%s.html", child->name);
+
+		json = list_to_json(ctx, root, child);
+		ret = render_page(ctx, name, ctx.gen->templates.list, json, "list");
+		cJSON_Delete(json);
+
+		free(name);
+		if (ret > 0) return ret;
+	}
+
+	return document_search(ctx, root);
+}
+
+/*
+	search.json lists every module and item by name, for a script to search on
+	the client; entries are sorted by name ignoring case, each name is stored as
+	the length of the prefix it shares with the one before and the rest, and
+	the path of the namespace or class it is in is stored once in parents
+
+	{ "aggregate": bool, "spa": bool, "parents": [path...], "fullText": shards,
+	  "entries": [[shared, rest, kind ("m", "c", "f" or "v"), parent]...] }
+
+	with --full-text, fulltext/NN.json are the shards of a trigram index over
+	the descriptions, which identifies each by its index in entries
+*/
+
+struct search_entry {
+	const char* name;
+	const char* kind;
+	int parent;
+	const char* desc;
+};
+
+static void search_add(
+	struct list* entries,
+	const char* name,
+	const char* kind,
+	int parent,
+	const char* desc
+) {
+	struct search_entry* entry = malloc(sizeof(struct search_entry));
+	*entry = (struct search_entry) { name, kind, parent, desc };
+
+	list_push(entries, entry);
+}
+
+static void search_items(
+	struct list* entries,
+	struct list* parents,
+	struct list* items,
+	const char* path
+) {
+	if (list_length(items) == 0) return;
+
+	int parent = list_length(parents);
+	list_push(parents, astrndup(path, strlen(path)));
+
+	static const char* kinds[] = { "v", "f", "c" };
+	LIST_ITER_T(items, item, struct item*)
+		search_add(entries, item->name, kinds[item->type], parent, item->desc);
+
+	LIST_ITER_T(items, item, struct item*) {
+		if (item->type != ITEM_CLASS) continue;
 
-		ctx.output = dir;
-		list_pop(ctx.stack);
+		char* class_path = *path
+			? asprintf("%s.%s", path, item->name)
+			: asprintf("%s", item->name);
+		search_items(entries, parents, item->items, class_path);
+		free(class_path);
 	}
-
-	return 0;
 }
 
-static const char* type_keys[] = {
-	[ITEM_VAR] = "vars",
-	[ITEM_FUNC] = "funcs",
-	[ITEM_CLASS] = "classes",
-};
-
-static void all_class_to_json(
-	cJSON *root,
-	struct item *class,
-	struct list *stack
+static void search_module(
+	struct list* entries,
+	struct list* parents,
+	struct module* module,
+	const char* path
 ) {
-	list_push(stack, class->name);
+	search_items(entries, parents, module->items, path);
 
-	LIST_ITER_T(class->items, item, struct item *) {
-		cJSON *array = cJSON_GetObjectItem(root, type_keys[item->type]);
-		cJSON *entry = cJSON_CreateArray();
+	if (list_length(module->children) == 0) return;
 
-		LIST_ITER_T(stack, parent, const char *) {
-			cJSON_AddItemToArray(entry, cJSON_CreateString(parent));
-		}
-		cJSON_AddItemToArray(entry, cJSON_CreateString(item->name));
+	int parent = list_length(parents);
+	list_push(parents, astrndup(path, strlen(path)));
 
-		cJSON_AddItemToArray(array, entry);
+	LIST_ITER_T(module->children, child, struct module*) {
+		search_add(entries, child->name, "m", parent, child->desc);
 
-		if (item->type == ITEM_CLASS) all_class_to_json(root, item, stack);
+		char* child_path = *path
+			? asprintf("%s.%s", path, child->name)
+			: asprintf("%s", child->name);
+		search_module(entries, parents, child, child_path);
+		free(child_path);
 	}
+}
 
-	list_pop(stack);
+static int comp_search_entry(const void* a, const void* b) {
+	const struct search_entry* entry_a = *(const struct search_entry**) a;
+	const struct search_entry* entry_b = *(const struct search_entry**) b;
+
+	int comp = strcasecmp(entry_a->name, entry_b->name);
+	if (comp == 0) comp = strcmp(entry_a->name, entry_b->name);
+	if (comp == 0) comp = entry_a->parent - entry_b->parent;
+
+	return comp;
 }
 
-static void all_to_json(
-	cJSON *root,
-	struct module *module,
-	struct list *stack
+static void search_collect(
+	struct module* root,
+	struct list** entries,
+	struct list** parents
 ) {
-	list_push(stack, module->name);
+	*entries = list_new();
+	*parents = list_new();
 
-	LIST_ITER_T(module->items, item, struct item *) {
-		cJSON *array = cJSON_GetObjectItem(root, type_keys[item->type]);
-		cJSON *entry = cJSON_CreateArray();
+	search_module(*entries, *parents, root, "");
+	list_sort(*entries, comp_search_entry);
+}
 
-		LIST_ITER_T(stack, parent, const char *) {
-			cJSON_AddItemToArray(entry, cJSON_CreateString(parent));
-		}
-		cJSON_AddItemToArray(entry, cJSON_CreateString(item->name));
+static char* search_to_json(
+	struct ctx ctx,
+	struct list* entries,
+	struct list* parents
+) {
+	cJSON* json = cJSON_CreateObject();
+	cJSON_AddBoolToObject(json, "aggregate", ctx.opts->aggregate);
+	cJSON_AddBoolToObject(json, "spa", ctx.opts->spa);
+	cJSON_AddNumberToObject(
+		json, "fullText", ctx.opts->full_text ? FULLTEXT_SHARDS : 0
+	);
 
-		cJSON_AddItemToArray(array, entry);
+	cJSON* parents_json = cJSON_AddArrayToObject(json, "parents");
+	LIST_ITER_T(parents, parent, const char*)
+		cJSON_AddItemToArray(parents_json, cJSON_CreateString(parent));
 
-		if (item->type == ITEM_CLASS) all_class_to_json(root, item, stack);
-	}
+	cJSON* entries_json = cJSON_AddArrayToObject(json, "entries");
+	const char* last = "";
 
-	LIST_ITER_T(module->children, child, struct module *) {
-		all_to_json(root, child, stack);
+	LIST_ITER_T(entries, entry, struct search_entry*) {
+		size_t shared = 0;
+		while (last[shared] && last[shared] == entry->name[shared]) shared++;
+
+		cJSON* nd = cJSON_CreateArray();
+		cJSON_AddItemToArray(nd, cJSON_CreateNumber((double) shared));
+		cJSON_AddItemToArray(nd, cJSON_CreateString(entry->name + shared));
+		cJSON_AddItemToArray(nd, cJSON_CreateString(entry->kind));
+		cJSON_AddItemToArray(nd, cJSON_CreateNumber((double) entry->parent));
+		cJSON_AddItemToArray(entries_json, nd);
+
+		last = entry->name;
 	}
 
-	list_pop(stack);
+	char* data = cJSON_PrintUnformatted(json);
+	cJSON_Delete(json);
+
+	return data;
 }
 
-static int document_list(struct ctx ctx, struct module* root) {
-	int fd = openat(
-		dirfd(ctx.output), "list.html", O_CREAT | O_WRONLY | O_TRUNC, FILE_FLAGS
+static char** search_full_text(struct list* entries, size_t* n_trigrams) {
+	const char** descs = malloc((list_length(entries) + 1) * sizeof(char*));
+
+	size_t n_descs = 0;
+	LIST_ITER_T(entries, entry, struct search_entry*)
+		descs[n_descs++] = entry->desc;
+
+	char** shards = fulltext_build(descs, n_descs, n_trigrams);
+	free(descs);
+
+	return shards;
+}
+
+static int document_full_text(struct ctx ctx, struct list* entries) {
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	size_t n_trigrams;
+	char** shards = search_full_text(entries, &n_trigrams);
+	if (shards == NULL) return 3;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	errorf(
+		"built full-text index of %zu trigrams in %.1f ms\n", n_trigrams,
+		(end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6
 	);
-	if (fd == -1) {
-		perrorf("failed to open output");
-		return 2;
-	}
 
-	FILE *file = fdopen(fd, "w");
-	if (!file) {
-		perrorf("failed to open output");
-		return 2;
+	int ret = 0;
+	for (int shard = 0; shard < FULLTEXT_SHARDS && ret == 0; shard++) {
+		char path[32];
+		snprintf(path, sizeof(path), "fulltext/%02d.json", shard);
+
+		if (ctx.aliases) {
+			struct depend_all all = { &ctx, path };
+			map_iter(ctx.aliases, depend_source, &all);
+		}
+
+		ret = write_output(path, shards[shard], strlen(shards[shard]), &ctx);
 	}
 
-	cJSON *json = cJSON_CreateObject();
-	cJSON_AddStringToObject(json, "root", "./");
-	cJSON_AddStringToObject(json, "library", ctx.opts->library);
-	cJSON_AddArrayToObject(json, "vars");
-	cJSON_AddArrayToObject(json, "funcs");
-	cJSON_AddArrayToObject(json, "classes");
+	fulltext_free(shards);
 
-	struct list *stack = list_new();
-	all_to_json(json, root, stack);
-	list_free(stack, NULL);
+	return ret;
+}
 
-	lattice_error *err = NULL;
-	const char *search[] = { ctx.templates.dir, NULL };
-	lattice_opts opts = { .search = search, .ignore_emit_zero = true };
-	lattice_cjson_file(ctx.templates.list, json, file, opts, &err);
+static int document_search(struct ctx ctx, struct module* root) {
+	struct list *entries, *parents;
+	search_collect(root, &entries, &parents);
 
-	fclose(file);
-	cJSON_Delete(json);
+	int ret = 0;
+	char* data = search_to_json(ctx, entries, parents);
 
-	if (err) {
-		perrorf("failed to render module template (%s)", err->message);
+	if (data == NULL) {
+		errorf("failed to serialise the search index\n");
+		ret = 3;
+	} else {
+		if (ctx.aliases) {
+			struct depend_all all = { &ctx, "search.json" };
+			map_iter(ctx.aliases, depend_source, &all);
+		}
 
-		lattice_error_code code = err->code;
-		lattice_error_free(err);
-		return code == LATTICE_IO_ERROR ? 2 : 3;
+		ret = write_output("search.json", data, strlen(data), &ctx);
+		free(data);
 	}
 
-	return 0;
+	if (ret == 0 && ctx.opts->full_text) ret = document_full_text(ctx, entries);
+
+	list_free(entries, free);
+	list_free(parents, free);
+
+	return ret;
 }
 
 struct directory {
@@ -676,10 +2497,18 @@ static int create_source_dirs(int parent, struct directory *dir) {
 	return 0;
 }
 
-static int document_sources(struct ctx ctx, struct source sources[]) {
+// builds the json shared by the source pages; source directories are created
+// in src_fd as a side effect, unless it is -1
+static cJSON* sources_to_json(
+	struct ctx ctx,
+	struct source sources[],
+	int src_fd
+) {
 	cJSON *json = cJSON_CreateObject();
 	cJSON_AddStringToObject(json, "root", "./");
 	cJSON_AddStringToObject(json, "library", ctx.opts->library);
+	cJSON_AddStringToObject(json, "generated", ctx.gen->generated);
+	cJSON_AddBoolToObject(json, "aggregate", ctx.opts->aggregate);
 	cJSON_AddNullToObject(json, "path");
 	cJSON_AddNullToObject(json, "contents");
 	cJSON *array = cJSON_AddArrayToObject(json, "tree");
@@ -752,48 +2581,82 @@ static int document_sources(struct ctx ctx, struct source sources[]) {
 
 	list_free(stack, NULL);
 
-	if (mkdirat(dirfd(ctx.output), "src", DIR_FLAGS) == -1) {
-		if (errno != EEXIST) {
-			perrorf("failed to create output dir");
-			return 2;
-		}
+	if (src_fd != -1 && create_source_dirs(src_fd, &root) > 0) {
+		cJSON_Delete(json);
+		return NULL;
 	}
 
-	int src_fd = openat(dirfd(ctx.output), "src", O_DIRECTORY);
-	if (create_source_dirs(src_fd, &root) > 0) return 2;
-	close(src_fd);
-
 	char buffer[max + 2];
 	buffer[0] = 0;
 	dir_to_json(array, &root, buffer, 0);
 
-	int fd = openat(
-		dirfd(ctx.output), "src.html", O_CREAT | O_WRONLY | O_TRUNC, FILE_FLAGS
-	);
-	if (fd == -1) {
-		perrorf("failed to open output");
+	return json;
+}
+
+static int source_to_json(cJSON* json, struct source* source) {
+	cJSON_DeleteItemFromObject(json, "root");
+	cJSON_DeleteItemFromObject(json, "path");
+	cJSON_DeleteItemFromObject(json, "contents");
+
+	char *contents = read_file(source->file);
+	if (!contents) {
+		perrorf("failed to read source file");
 		return 2;
 	}
 
-	FILE *file = fdopen(fd, "w");
-	if (!file) {
-		perrorf("failed to open output");
-		return 2;
+	size_t dotdots = 1;
+	for (size_t i = 0; source->alias[i]; i++)
+		if (source->alias[i] == '/') dotdots++;
+
+	char root[dotdots * 3 + 1];
+	for (size_t i = 0; i < dotdots; i++) strcpy(root + i * 3, "../");
+
+	cJSON_AddStringToObject(json, "root", root);
+	cJSON_AddStringToObject(json, "path", source->alias);
+	cJSON_AddStringToObject(json, "contents", contents);
+	free(contents);
+
+	return 0;
+}
+
+// writes the tree of all the sources once, for the source pages to fetch, then
+// leaves it out of their json so that each page only holds its own source
+static int document_tree(struct ctx ctx, cJSON* json) {
+	char* data = cJSON_PrintUnformatted(cJSON_GetObjectItem(json, "tree"));
+	if (data == NULL) {
+		errorf("failed to serialise the source tree\n");
+		return 3;
 	}
 
-	lattice_error *err = NULL;
-	const char *search[] = { ctx.templates.dir, NULL };
-	lattice_opts opts = { .search = search, .ignore_emit_zero = true };
+	if (ctx.aliases) {
+		struct depend_all all = { &ctx, "src/tree.json" };
+		map_iter(ctx.aliases, depend_source, &all);
+	}
 
-	lattice_cjson_file(ctx.templates.source, json, file, opts, &err);
-	fclose(file);
+	int ret = write_output("src/tree.json", data, strlen(data), &ctx);
+	free(data);
 
-	if (err) {
-		perrorf("failed to render sources template (%s)", err->message);
+	cJSON_ReplaceItemInObject(json, "tree", cJSON_CreateArray());
 
-		lattice_error_code code = err->code;
-		lattice_error_free(err);
-		return code == LATTICE_IO_ERROR ? 2 : 3;
+	return ret;
+}
+
+static int document_sources(struct ctx ctx, struct source sources[]) {
+	if (make_dir(ctx, "src") > 0) return 2;
+
+	int src_fd = ctx.sink ? -1 : openat(ctx.output, "src", O_DIRECTORY);
+	cJSON* json = sources_to_json(ctx, sources, src_fd);
+	if (src_fd != -1) close(src_fd);
+
+	if (json == NULL) return 2;
+
+	int ret = render_page(
+		ctx, "src.html", ctx.gen->templates.source, json, "sources"
+	);
+	if (ret == 0) ret = document_tree(ctx, json);
+	if (ret > 0) {
+		cJSON_Delete(json);
+		return ret;
 	}
 
 	for (struct source *source = sources; source->file; source++) {
@@ -804,50 +2667,382 @@ static int document_sources(struct ctx ctx, struct source sources[]) {
 		strcpy(path + 4, source->alias);
 		strcpy(path + path_len + 4, ".html");
 
-		fd = openat(dirfd(ctx.output), path, O_CREAT | O_WRONLY | O_TRUNC, FILE_FLAGS);
-		if (fd == -1) {
-			perrorf("failed to open output");
-			return 2;
+		if (source_to_json(json, source) > 0) {
+			ret = 2;
+			break;
 		}
 
-		file = fdopen(fd, "w");
-		if (!file) {
-			perrorf("failed to open output");
-			return 2;
+		if (ctx.aliases) {
+			ctx.deps = list_new();
+			list_push(ctx.deps, (void*) source->alias);
 		}
 
-		cJSON_DeleteItemFromObject(json, "root");
-		cJSON_DeleteItemFromObject(json, "path");
-		cJSON_DeleteItemFromObject(json, "contents");
+		ret = render_page(ctx, path, ctx.gen->templates.source, json, "sources");
+		list_free(ctx.deps, NULL);
+		ctx.deps = NULL;
 
-		char *contents = read_file(source->file);
-		if (!contents) {
-			perrorf("failed to read source file");
-			return 2;
+		if (ret > 0) break;
+	}
+
+	cJSON_Delete(json);
+	return ret;
+}
+
+static struct buffer* render_buffer(
+	struct ctx ctx,
+	const char* template,
+	cJSON* json,
+	const char* what
+) {
+	struct buffer* buffer = malloc(sizeof(struct buffer));
+
+	FILE* file = open_memstream(&buffer->data, &buffer->length);
+	int ret = render_template(ctx, template, json, file, what);
+	fclose(file);
+
+	if (ret > 0) {
+		buffer_free(buffer);
+		return NULL;
+	}
+
+	return buffer;
+}
+
+// renders data/root.PATH.json, walking down the tree the same way as
+// document_module_data so that the stack matches
+static struct buffer* render_data(
+	struct ctx ctx,
+	struct module* root,
+	const char* path
+) {
+	size_t length = strlen(path);
+	if (length < 14 || strcmp(path + length - 5, ".json")) return NULL;
+
+	// the dotted path, with a dot before each name
+	char dotted[length];
+	strncpy(dotted, path + 9, length - 14);
+	dotted[length - 14] = 0;
+
+	struct module* module = root;
+	struct item* class = NULL;
+	const char* segment = dotted;
+
+	while (*segment) {
+		if (*segment != '.') return NULL;
+		segment++;
+
+		size_t name_length = strcspn(segment, ".");
+		char name[name_length + 1];
+		strncpy(name, segment, name_length);
+		name[name_length] = 0;
+
+		struct module* child = NULL;
+		if (class == NULL)
+			child = list_iter(module->children, filter_module_name, name);
+
+		list_push(ctx.stack, class ? class->name : module->name);
+
+		if (child) {
+			module = child;
+		} else {
+			class = list_iter(
+				class ? class->items : module->items, filter_item_name, name
+			);
+			if (class == NULL || class->type != ITEM_CLASS) return NULL;
+		}
+
+		segment += name_length;
+	}
+
+	cJSON* json =
+		class ? item_to_json(ctx, class) : module_to_json(ctx, module);
+
+	struct buffer* buffer = malloc(sizeof(struct buffer));
+	buffer->data = cJSON_PrintUnformatted(json);
+	buffer->length = buffer->data ? strlen(buffer->data) : 0;
+	cJSON_Delete(json);
+
+	if (buffer->data == NULL) {
+		free(buffer);
+		return NULL;
+	}
+
+	return buffer;
+}
+
+static struct buffer* render_path(
+	struct ctx ctx,
+	struct module* root,
+	struct source sources[],
+	const char* path
+) {
+	if (ctx.opts->spa) {
+		if (path[0] == 0 || strcmp(path, "index.html") == 0) {
+			cJSON* json = cJSON_CreateObject();
+			cJSON_AddStringToObject(json, "root", "./");
+			cJSON_AddStringToObject(json, "library", ctx.opts->library);
+			cJSON_AddStringToObject(json, "generated", ctx.gen->generated);
+			cJSON_AddBoolToObject(json, "aggregate", ctx.opts->aggregate);
+
+			struct buffer* buffer =
+				render_buffer(ctx, ctx.gen->templates.app, json, "app");
+			cJSON_Delete(json);
+
+			return buffer;
 		}
 
-		size_t dotdots = 0;
-		for (size_t i = 0; path[i]; i++) if (path[i] == '/') dotdots++;
-		char root[dotdots * 3 + 1];
-		for (size_t i = 0; i < dotdots; i++) strcpy(root + i * 3, "../");
+		if (strncmp(path, "data/root", 9) == 0) return render_data(ctx, root, path);
+	}
 
-		cJSON_AddStringToObject(json, "root", root);
-		cJSON_AddStringToObject(json, "path", source->alias);
-		cJSON_AddStringToObject(json, "contents", contents);
-		free(contents);
+	// the whole index is built for any part of it
+	int shard = -1;
+	if (ctx.opts->full_text && strncmp(path, "fulltext/", 9) == 0) {
+		char* end;
+		shard = strtol(path + 9, &end, 10);
 
-		lattice_cjson_file(ctx.templates.source, json, file, opts, &err);
-		fclose(file);
+		bool valid = end != path + 9 && strcmp(end, ".json") == 0;
+		if (!valid || shard < 0 || shard >= FULLTEXT_SHARDS) return NULL;
+	}
+
+	if (shard >= 0 || strcmp(path, "search.json") == 0) {
+		struct list *entries, *parents;
+		search_collect(root, &entries, &parents);
+
+		char* data = NULL;
+		if (shard < 0) {
+			data = search_to_json(ctx, entries, parents);
+		} else {
+			size_t n_trigrams;
+			char** shards = search_full_text(entries, &n_trigrams);
+
+			if (shards) {
+				data = shards[shard];
+				shards[shard] = NULL;
+			}
+
+			fulltext_free(shards);
+		}
+
+		list_free(entries, free);
+		list_free(parents, free);
+
+		if (data == NULL) return NULL;
+
+		struct buffer* buffer = malloc(sizeof(struct buffer));
+		buffer->data = data;
+		buffer->length = strlen(data);
+
+		return buffer;
+	}
+
+	size_t length = strlen(path);
+	bool shard_path =
+		ctx.opts->shard_list && length > 10 &&
+		strncmp(path, "list.", 5) == 0 && strcmp(path + length - 5, ".html") == 0;
+
+	if (strcmp(path, "list.html") == 0 || shard_path) {
+		struct module* shard = NULL;
+
+		if (shard_path) {
+			char name[length - 9];
+			strncpy(name, path + 5, length - 10);
+			name[length - 10] = 0;
+
+			shard = list_iter(root->children, filter_module_name, name);
+			if (shard == NULL) return NULL;
+		}
+
+		cJSON* json = list_to_json(ctx, root, shard);
+
+		struct buffer* buffer =
+			render_buffer(ctx, ctx.gen->templates.list, json, "list");
+		cJSON_Delete(json);
+
+		return buffer;
+	}
+
+	if (strcmp(path, "src/tree.json") == 0) {
+		cJSON* json = sources_to_json(ctx, sources, -1);
+
+		struct buffer* buffer = malloc(sizeof(struct buffer));
+		buffer->data = cJSON_PrintUnformatted(cJSON_GetObjectItem(json, "tree"));
+		buffer->length = buffer->data ? strlen(buffer->data) : 0;
+		cJSON_Delete(json);
+
+		if (buffer->data == NULL) {
+			free(buffer);
+			return NULL;
+		}
+
+		return buffer;
+	}
+
+	if (strcmp(path, "src.html") == 0 || strncmp(path, "src/", 4) == 0) {
+		struct source* source = NULL;
+		if (path[3] == '/') {
+			size_t length = strlen(path + 4);
+			if (length < 5 || strcmp(path + 4 + length - 5, ".html")) return NULL;
+
+			for (struct source* test = sources; test->file; test++) {
+				if (
+					strncmp(test->alias, path + 4, length - 5) == 0 &&
+					test->alias[length - 5] == 0
+				) source = test;
+			}
+
+			if (source == NULL) return NULL;
+		}
+
+		cJSON* json = sources_to_json(ctx, sources, -1);
+		if (source) cJSON_ReplaceItemInObject(json, "tree", cJSON_CreateArray());
+		if (source && source_to_json(json, source) > 0) {
+			cJSON_Delete(json);
+			return NULL;
+		}
+
+		struct buffer* buffer =
+			render_buffer(ctx, ctx.gen->templates.source, json, "sources");
+		cJSON_Delete(json);
+
+		return buffer;
+	}
+
+	// walk down the tree the same way as document_module and document_item, so
+	// that the stack matches what the page would see when written out in full
+	struct module* module = root;
+	struct item* class = NULL;
+
+	list_push(ctx.stack, root->name);
+
+	const char* segment = path;
+	const char* slash;
+
+	while ((slash = strchr(segment, '/')) != NULL) {
+		char name[slash - segment + 1];
+		strncpy(name, segment, slash - segment);
+		name[slash - segment] = 0;
+
+		struct module* child = NULL;
+		struct item* item = NULL;
+
+		if (class == NULL)
+			child = list_iter(module->children, filter_module_name, name);
+
+		if (child) {
+			module = child;
+		} else {
+			item = list_iter(
+				class ? class->items : module->items, filter_item_name, name
+			);
+			if (item == NULL || item->type != ITEM_CLASS) return NULL;
+
+			class = item;
+		}
+
+		list_push(ctx.stack, child ? child->name : item->name);
+		segment = slash + 1;
+	}
 
-		if (err) {
-			perrorf("failed to render sources template (%s)", err->message);
+	cJSON* json = NULL;
+	const char* template = ctx.gen->templates.item;
+	const char* what = "item";
 
-			lattice_error_code code = err->code;
-			lattice_error_free(err);
-			return code == LATTICE_IO_ERROR ? 2 : 3;
+	if (segment[0] == 0 || strcmp(segment, "index.html") == 0) {
+		list_pop(ctx.stack);
+
+		if (class) {
+			json = item_to_json(ctx, class);
+		} else {
+			json = module_to_json(ctx, module);
+			template = ctx.gen->templates.module;
+			what = "module";
+		}
+	} else {
+		enum item_type type;
+		const char* name;
+
+		if (ctx.opts->aggregate) {
+			return NULL;
+		} else if (strncmp(segment, "var.", 4) == 0) {
+			type = ITEM_VAR;
+			name = segment + 4;
+		} else if (strncmp(segment, "func.", 5) == 0) {
+			type = ITEM_FUNC;
+			name = segment + 5;
+		} else {
+			return NULL;
 		}
+
+		size_t length = strlen(name);
+		if (length < 5 || strcmp(name + length - 5, ".html")) return NULL;
+
+		char bare[length - 4];
+		strncpy(bare, name, length - 5);
+		bare[length - 5] = 0;
+
+		struct item* item = list_iter(
+			class ? class->items : module->items, filter_item_name, bare
+		);
+		if (item == NULL || item->type != type) return NULL;
+
+		json = item_to_json(ctx, item);
 	}
 
+	struct buffer* buffer = render_buffer(ctx, template, json, what);
 	cJSON_Delete(json);
+
+	return buffer;
+}
+
+static void* match_static(const char* name, void* hashed, void* user) {
+	const char* path = *(const char**) user;
+	if (strcmp(hashed, path) != 0) return NULL;
+
+	return (void*) name;
+}
+
+// finds the static written as path, which is under its hashed name when the
+// statics are hashed
+static struct buffer* find_static(struct generator* gen, const char* path) {
+	if (!gen->static_names) return map_get(gen->statics, path);
+
+	const char* name = map_iter(gen->static_names, match_static, &path);
+	return name ? map_get(gen->statics, name) : NULL;
+}
+
+int generator_render(
+	struct generator* gen,
+	struct module* root,
+	struct source sources[],
+	const char* path,
+	const char** data,
+	size_t* length
+) {
+	if (gen->rendered == NULL) gen->rendered = map_new();
+
+	struct buffer* buffer = map_get(gen->rendered, path);
+
+	if (buffer == NULL) {
+		struct ctx ctx = {
+			.gen = gen,
+			.output = -1,
+			.path = "",
+			.stack = list_new(),
+			.opts = &gen->opts,
+		};
+
+		buffer = render_path(ctx, root, sources, path);
+		list_free(ctx.stack, NULL);
+
+		// static files are served straight from where they were loaded
+		if (buffer == NULL) buffer = find_static(gen, path);
+		else map_set(gen->rendered, path, buffer);
+
+		if (buffer == NULL) return -1;
+	}
+
+	*data = buffer->data;
+	*length = buffer->length;
+
 	return 0;
 }
@@ -2,21 +2,101 @@
 #define GENERATE_H
 
 #include <stdbool.h>
+#include <stddef.h>
 
 #include "parse.h"
 
+enum output_format {
+	FORMAT_HTML = 1,
+	FORMAT_JSON = 2,
+	FORMAT_MARKDOWN = 4,
+	FORMAT_MAN = 8,
+};
+
 struct generate_options {
 	const char* library;
 	const char* output;
 	const char* template;
 	bool no_markdown;
+	bool memoise;
+	bool incremental;
+	const char** only;
+	bool only_list, only_sources;
+	const char* depfile;
+	const char* symbols;
+	unsigned formats;    /* output_format; 0 for only html */
+	const char** themes; /* extra template dirs, each output to a subdir */
+	const char* model;
+	bool model_lines;    /* write the model as ndjson */
+	bool aggregate;      /* vars and funcs are sections of their parent page */
+	bool shard_list;     /* list.html per top-level module, and an index */
+	bool full_text;      /* trigram index of the descriptions for search */
+	bool spa;            /* one page, which fetches the data of each module */
+	bool precompress;    /* write a .gz (and .br) beside each file */
+	bool minify;         /* strip comments and indentation from templates */
+	bool hash_statics;   /* name statics by a hash of their contents */
+	bool manifest;       /* list the output files, and prune stale ones */
+	const char* static_store; /* dir the statics are hard linked from */
 };
 
 struct source {
 	const char* file;
 	const char* alias;
+	const char* module;
 };
 
+struct generator;
+
+// receives each output file instead of it being written to the output dir; a
+// nonzero return stops generation
+typedef int (* generator_sink)(
+	const char* path,
+	const char* data,
+	size_t length,
+	void* user
+);
+
+struct generator* generator_new(struct generate_options opts, int* status);
+int generator_reload(struct generator* gen);
+const char* generator_template(struct generator* gen);
+int generator_run(
+	struct generator* gen,
+	struct module* root,
+	struct source sources[]
+);
+int generator_run_library(
+	struct generator* gen,
+	struct module* root,
+	struct source sources[],
+	const char* library,
+	const char* output
+);
+int generator_run_sink(
+	struct generator* gen,
+	struct module* root,
+	struct source sources[],
+	generator_sink sink,
+	void* user
+);
+int generator_run_index(
+	struct generator* gen,
+	struct module* root,
+	struct source sources[]
+);
+int generator_run_module(struct generator* gen, struct module* module);
+void generator_free(struct generator* gen);
+
+char* generator_markdown(struct generator* gen, const char* raw);
+
+int generator_render(
+	struct generator* gen,
+	struct module* root,
+	struct source sources[],
+	const char* path,
+	const char** data,
+	size_t* length
+);
+
 int generate_docs(
 	struct module* root,
 	struct source sources[],
@@ -0,0 +1,599 @@
+#include <ctype.h>
+#include <dirent.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "generate.h"
+#include "input.h"
+#include "object.h"
+#include "parse.h"
+#include "util.h"
+
+static int comp_input(const struct input* a, const struct input* b) {
+	return strcmp(a->file, b->file);
+}
+
+static int search_dir(
+	char buf[PATH_MAX],
+	int buflen,
+	int skip,
+	struct input inputs[],
+	int* n_inputs
+) {
+	DIR* dir = opendir(buf);
+	if (dir == NULL) return 0;
+
+	struct dirent* dir_item;
+	while ((dir_item = readdir(dir))) {
+		if (strcmp(dir_item->d_name, ".") == 0) continue;
+		if (strcmp(dir_item->d_name, "..") == 0) continue;
+
+		int length = buflen + strlen(dir_item->d_name);
+		if (length + 2 > PATH_MAX) continue;
+
+		strcpy(buf + buflen, dir_item->d_name);
+
+		if (dir_item->d_type == DT_DIR) {
+			buf[length] = '/';
+			buf[length + 1] = 0;
+
+			if (search_dir(buf, length + 1, skip, inputs, n_inputs) == -1) {
+				closedir(dir);
+				return -1;
+			}
+		} else if (length >= 4 && strcmp(buf + length - 4, ".nas") == 0) {
+			if (*n_inputs >= MAX_INPUTS) {
+				errorf("too many input files (at most %d)\n", MAX_INPUTS);
+				closedir(dir);
+				return -1;
+			}
+
+			inputs[(*n_inputs)++] = (struct input) {
+				.file = astrndup(buf + skip, length - skip),
+				.module = NULL
+			};
+		}
+
+		buf[buflen] = 0;
+	}
+
+	closedir(dir);
+
+	return 0;
+}
+
+int search_inputs(const char* path, struct input inputs[], int* n_inputs) {
+	char buf[PATH_MAX];
+	int skip = 0;
+
+	if (path == NULL) {
+		strcpy(buf, "./");
+		skip = 2;
+	} else if (strlen(path) + 2 > PATH_MAX) {
+		errorf("'%s' is too long\n", path);
+		return -1;
+	} else {
+		strcpy(buf, path);
+		if (buf[strlen(buf) - 1] != '/') strcat(buf, "/");
+	}
+
+	int start = *n_inputs;
+	if (search_dir(buf, strlen(buf), skip, inputs, n_inputs) == -1) return -1;
+
+	// the order of directory entries is up to the filesystem
+	qsort(
+		inputs + start, *n_inputs - start, sizeof(struct input),
+		(int (*)(const void*, const void*)) comp_input
+	);
+
+	return 0;
+}
+
+int parse_inputs(
+	char* const args[],
+	int n_args,
+	struct input inputs[],
+	int* n_inputs
+) {
+	if (n_args > MAX_INPUTS) {
+		errorf("too many input files (at most %d)\n", MAX_INPUTS);
+		return -1;
+	}
+
+	*n_inputs = n_args;
+
+	for (int i = 0; i < n_args; i++) {
+		const char* module = strrchr(args[i], ':');
+
+		if (module == NULL) {
+			inputs[i] = (struct input) {
+				.file = astrndup(args[i], strlen(args[i])),
+				.module = NULL
+			};
+		} else {
+			char* file_clone = malloc(module - args[i] + 1);
+			strncpy(file_clone, args[i], module - args[i]);
+			file_clone[module - args[i]] = 0;
+
+			size_t module_len = args[i] + strlen(args[i]) - module - 1;
+			bool leading_dot = module[1] == '.';
+
+			inputs[i] = (struct input) {
+				.file = file_clone,
+				.module = astrndup(
+					module + 1 + leading_dot, module_len - leading_dot
+				)
+			};
+
+			bool last_was_dot = false;
+			for (int j = 1; j < module_len + 1; j++) {
+				if (module[j] == '.') {
+					if (last_was_dot || (j == module_len && j > 1)) {
+						errorf("'%s' is invalid\n", module + 1);
+						return -1;
+					}
+
+					last_was_dot = true;
+				} else {
+					if (!isalnum(module[j]) && module[j] != '_') {
+						errorf("'%s' is invalid\n", module + 1);
+						return -1;
+					}
+
+					last_was_dot = false;
+				}
+			}
+		}
+	}
+
+	if (*n_inputs == 0) return search_inputs(NULL, inputs, n_inputs);
+
+	// compiled objects stand in for the files they were compiled from, which
+	// are still needed for the source pages
+	for (int i = 0; i < n_args; i++) {
+		size_t length = strlen(inputs[i].file);
+		if (length < 4 || strcmp(inputs[i].file + length - 4, ".ndo") != 0)
+			continue;
+
+		char *source, *module;
+		if (read_object_header(inputs[i].file, &source, &module) > 0) return -1;
+
+		inputs[i].object = inputs[i].file;
+		inputs[i].file = source;
+
+		if (inputs[i].module == NULL) inputs[i].module = module;
+		else free(module);
+	}
+
+	return 0;
+}
+
+// finds the length of the longest directory prefix shared by the real paths of
+// the inputs, or of only those without a module if implicit is set
+static int common_prefix(
+	struct input inputs[],
+	int n_inputs,
+	bool implicit,
+	int* prefix
+) {
+	char* common = NULL;
+	char* segments[64] = { 0 };
+	int n_segments = 0;
+
+	for (int i = 0; i < n_inputs; i++) {
+		if (implicit && inputs[i].module != NULL) continue;
+
+		char* resolved = realpath(inputs[i].file, NULL);
+
+		if (resolved == NULL) {
+			perrorf("failed to resolve '%s'", inputs[i].file);
+			free(common);
+			return -1;
+		}
+
+		resolved[0] = 0;
+
+		char* current = resolved + 1;
+		char* last_current = current;
+		int current_n = 0;
+
+		if (common == NULL) segments[n_segments++] = current;
+
+		while ((current = strchr(current, '/')) != NULL) {
+			current[0] = 0;
+			current += 1;
+
+			if (common == NULL) {
+				segments[n_segments++] = current;
+			} else if (
+				n_segments <= current_n ||
+				strcmp(segments[current_n], last_current) != 0
+			) {
+				n_segments = current_n;
+				break;
+			} else {
+				current_n++;
+			}
+
+			last_current = current;
+		}
+
+		if (common == NULL) {
+			n_segments -= 1;
+			common = resolved;
+		} else {
+			if (current_n < n_segments) n_segments = current_n;
+
+			free(resolved);
+		}
+	}
+
+	*prefix = 1 + n_segments;
+	for (int i = 0; i < n_segments; i++)
+		*prefix += strlen(segments[i]);
+
+	free(common);
+
+	return 0;
+}
+
+int resolve_inputs(struct input inputs[], int n_inputs) {
+	// modules are named from the files without one, while every file, including
+	// those with a module and compiled objects, has a path for its source page
+	int module_prefix, source_prefix;
+	if (common_prefix(inputs, n_inputs, true, &module_prefix) == -1) return -1;
+	if (common_prefix(inputs, n_inputs, false, &source_prefix) == -1) return -1;
+
+	for (int i = 0; i < n_inputs; i++) {
+		char* full = realpath(inputs[i].file, NULL);
+		if (full == NULL) {
+			perrorf("failed to resolve '%s'", inputs[i].file);
+			return -1;
+		}
+
+		const char* source = full + source_prefix;
+		free(inputs[i].absolute);
+		inputs[i].absolute = astrndup(source, strlen(source));
+
+		if (inputs[i].module == NULL) {
+			char* resolved = full + module_prefix;
+			int resolved_len = strlen(resolved);
+
+			if (strcmp(resolved + resolved_len - 4, ".nas") == 0)
+				resolved[resolved_len - 4] = 0;
+
+			for (int j = 0; resolved[j]; j++) {
+				if (resolved[j] == '/')
+					resolved[j] = '.';
+				else if (!isalnum(resolved[j]) && resolved[j] != '_')
+					resolved[j] = '_';
+			}
+
+			inputs[i].module = astrndup(resolved, strlen(resolved));
+			inputs[i].derived = true;
+		}
+
+		free(full);
+	}
+
+	return 0;
+}
+
+void input_free(struct input* input) {
+	free(input->file);
+	free(input->absolute);
+	free(input->module);
+	free(input->object);
+}
+
+// paths are tried relative to the directory of the file which loads them, as
+// io.include does, and then as they are
+static char* resolve_load(const char* from, const char* path) {
+	if (path[0] != '/') {
+		const char* slash = strrchr(from, '/');
+		char* relative = asprintf("%.*s/%s", (int) (slash - from), from, path);
+		char* resolved = realpath(relative, NULL);
+
+		free(relative);
+		if (resolved != NULL) return resolved;
+	}
+
+	return realpath(path, NULL);
+}
+
+static bool valid_module(const char* module) {
+	if (module == NULL || module[0] == 0) return false;
+
+	for (int i = 0; module[i]; i++)
+		if (!isalnum(module[i]) && module[i] != '_') return false;
+
+	return true;
+}
+
+static void relabel_items(struct list* items, const char* filename) {
+	LIST_ITER_T(items, item, struct item*) {
+		item->filename = filename;
+		if (item->type == ITEM_CLASS) relabel_items(item->items, filename);
+	}
+}
+
+static void relabel_module(struct module* module, const char* filename) {
+	module->filename = filename;
+
+	LIST_ITER_T(module->children, child, struct module*)
+		relabel_module(child, filename);
+	relabel_items(module->items, filename);
+}
+
+// starting from the entry files, parses each file as it is found to be loaded
+// by io.load_nasal or io.include, so that unreachable files are never read;
+// included files share the module of the file which includes them
+int reach_inputs(
+	char* const entries[],
+	int n_entries,
+	struct input inputs[],
+	int* n_inputs,
+	struct module* fragments[]
+) {
+	if (parse_inputs(entries, n_entries, inputs, n_inputs) == -1) return 1;
+
+	char* resolved[MAX_INPUTS];
+	int parent[MAX_INPUTS];
+	int ret = 0;
+	int n_parsed = 0;
+
+	for (int i = 0; i < *n_inputs; i++) {
+		parent[i] = -1;
+		resolved[i] = realpath(inputs[i].file, NULL);
+
+		if (resolved[i] == NULL) {
+			perrorf("failed to resolve '%s'", inputs[i].file);
+			*n_inputs = i;
+			ret = 2;
+			break;
+		}
+	}
+
+	for (; ret == 0 && n_parsed < *n_inputs; n_parsed++) {
+		int i = n_parsed;
+
+		struct list* loads = list_new();
+		fragments[i] = calloc(1, sizeof(struct module));
+		fragments[i]->children = list_new();
+		fragments[i]->items = list_new();
+
+		ret = parse_file_loads(inputs[i].file, inputs[i].file, fragments[i], loads);
+		if (ret > 0) {
+			module_free(fragments[i]);
+			list_free(loads, (void (*)(void*)) load_free);
+			break;
+		}
+
+		LIST_ITER_T(loads, load, struct load*) {
+			char* path = resolve_load(resolved[i], load->path);
+			if (path == NULL) {
+				errorf(
+					"%s:%d: '%s' was not found, skipping\n",
+					inputs[i].file, load->line, load->path
+				);
+				continue;
+			}
+
+			int j;
+			for (j = 0; j < *n_inputs; j++)
+				if (strcmp(resolved[j], path) == 0) break;
+
+			if (j < *n_inputs) {
+				free(path);
+				continue;
+			}
+
+			if (*n_inputs >= MAX_INPUTS) {
+				errorf("too many input files (at most %d)\n", MAX_INPUTS);
+				free(path);
+				ret = 1;
+				break;
+			}
+
+			bool named = !load->include && valid_module(load->module);
+
+			resolved[j] = path;
+			parent[j] = load->include ? i : -1;
+			inputs[j] = (struct input) {
+				.file = path,
+				.module = named ? astrndup(load->module, strlen(load->module)) : NULL,
+			};
+
+			(*n_inputs)++;
+		}
+
+		list_free(loads, (void (*)(void*)) load_free);
+	}
+
+	if (ret == 0 && resolve_inputs(inputs, *n_inputs) == -1) ret = 2;
+
+	if (ret > 0) {
+		for (int i = 0; i < n_parsed; i++) module_free(fragments[i]);
+		for (int i = 0; i < n_entries && i < *n_inputs; i++) free(resolved[i]);
+		return ret;
+	}
+
+	for (int i = 0; i < *n_inputs; i++) {
+		if (parent[i] != -1) {
+			const char* module = inputs[parent[i]].module;
+
+			free(inputs[i].module);
+			inputs[i].module = astrndup(module, strlen(module));
+		}
+
+		relabel_module(fragments[i], inputs[i].absolute);
+	}
+
+	for (int i = 0; i < n_entries && i < *n_inputs; i++) free(resolved[i]);
+
+	return 0;
+}
+
+static void* filter_name_eq(void* item, void* compare) {
+	return strcmp(((struct module*) item)->name, compare) == 0 ? item : NULL;
+}
+
+static struct module* find_or_create_module(
+	struct module* current,
+	const char* segment,
+	size_t length,
+	struct list* containers
+) {
+	char name[length + 1];
+	strncpy(name, segment, length);
+	name[length] = 0;
+
+	struct module* select = list_iter(current->children, filter_name_eq, name);
+	if (select == NULL) {
+		select = calloc(1, sizeof(struct module));
+		select->name = astrndup(name, length);
+		select->children = list_new();
+		select->items = list_new();
+
+		list_push(current->children, select);
+		list_push(containers, select);
+	}
+
+	return select;
+}
+
+static int comp_filename(const char* a, const char* b) {
+	if (a == NULL || b == NULL) return (a != NULL) - (b != NULL);
+	return strcmp(a, b);
+}
+
+// qsort is not stable, so ties are broken by everything which tells items
+// apart, so that the order depends only on the inputs
+static int comp_module(const struct module** a, const struct module** b) {
+	int comp = strcmp((*a)->name, (*b)->name);
+	if (comp == 0) comp = comp_filename((*a)->filename, (*b)->filename);
+	if (comp == 0) comp = (*a)->line - (*b)->line;
+
+	return comp;
+}
+
+static int comp_item(const struct item** a, const struct item** b) {
+	int comp = strcmp((*a)->name, (*b)->name);
+	if (comp == 0) comp = (int) (*a)->type - (int) (*b)->type;
+	if (comp == 0) comp = comp_filename((*a)->filename, (*b)->filename);
+	if (comp == 0) comp = (*a)->line - (*b)->line;
+
+	return comp;
+}
+
+static void sort_items(struct list* items) {
+	list_sort(items, (int (*)(const void*, const void*)) comp_item);
+	LIST_ITER_T(items, item, struct item*) {
+		if (item->type == ITEM_CLASS) sort_items(item->items);
+	}
+}
+
+void sort_module(struct module* current) {
+	list_sort(current->children, (int (*)(const void*, const void*)) comp_module);
+	LIST_ITER_T(current->children, child, struct module*) {
+		sort_module(child);
+	}
+
+	sort_items(current->items);
+}
+
+int parse_input(struct input* input, struct module** fragment) {
+	if (input->object)
+		return read_object(input->object, input->absolute, fragment);
+
+	struct module* parsed = calloc(1, sizeof(struct module));
+	parsed->children = list_new();
+	parsed->items = list_new();
+
+	int ret = parse_file(input->file, input->absolute, parsed);
+	if (ret > 0) {
+		module_free(parsed);
+		return ret;
+	}
+
+	*fragment = parsed;
+	return 0;
+}
+
+// the parsed files are kept as separate fragments, and the module tree is
+// assembled from them using containers which borrow their contents; this way a
+// single fragment can be replaced without parsing everything again
+struct module* assemble_tree(
+	struct input inputs[],
+	struct module* fragments[],
+	int n_inputs,
+	const char* desc,
+	struct list* containers
+) {
+	struct module* root = calloc(1, sizeof(struct module));
+	root->name = astrndup("", 0);
+	root->desc = (char*) desc;
+	root->children = list_new();
+	root->items = list_new();
+
+	list_push(containers, root);
+
+	for (int i = 0; i < n_inputs; i++) {
+		struct module* current = root;
+		const char* segment = inputs[i].module;
+		const char* next_segment;
+
+		while ((next_segment = strchr(segment, '.')) != NULL) {
+			current = find_or_create_module(
+				current, segment, next_segment - segment, containers
+			);
+			segment = next_segment + 1;
+		}
+
+		current = find_or_create_module(
+			current, segment, strlen(segment), containers
+		);
+		// a module made of several files, through io.include, is described by the
+		// first of them, which is the one including the others
+		if (current->filename == NULL) {
+			current->filename = inputs[i].absolute;
+			current->line = 1;
+		}
+		if (current->desc == NULL) current->desc = fragments[i]->desc;
+
+		LIST_ITER_T(fragments[i]->children, child, struct module*)
+			list_push(current->children, child);
+		LIST_ITER_T(fragments[i]->items, item, struct item*)
+			list_push(current->items, item);
+	}
+
+	sort_module(root);
+
+	return root;
+}
+
+void container_free(struct module* container) {
+	list_free(container->children, NULL);
+	list_free(container->items, NULL);
+
+	free(container->name);
+	free(container);
+}
+
+void inputs_to_sources(
+	struct input inputs[],
+	int n_inputs,
+	struct source sources[]
+) {
+	for (int i = 0; i < n_inputs; i++) {
+		sources[i].file = inputs[i].file;
+		sources[i].alias = inputs[i].absolute;
+		sources[i].module = inputs[i].module;
+	}
+
+	sources[n_inputs].file = NULL;
+}
@@ -0,0 +1,52 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include "generate.h"
+#include "parse.h"
+#include "util.h"
+
+#define MAX_INPUTS 1024
+
+struct input {
+	char* file;
+	char* absolute;
+	char* module;
+	char* object; /* compiled object to load instead of parsing file */
+	bool derived; /* module was derived from the path by resolve_inputs */
+};
+
+int parse_inputs(
+	char* const args[],
+	int n_args,
+	struct input inputs[],
+	int* n_inputs
+);
+int search_inputs(const char* path, struct input inputs[], int* n_inputs);
+int resolve_inputs(struct input inputs[], int n_inputs);
+void input_free(struct input* input);
+int reach_inputs(
+	char* const entries[],
+	int n_entries,
+	struct input inputs[],
+	int* n_inputs,
+	struct module* fragments[]
+);
+
+int parse_input(struct input* input, struct module** fragment);
+struct module* assemble_tree(
+	struct input inputs[],
+	struct module* fragments[],
+	int n_inputs,
+	const char* desc,
+	struct list* containers
+);
+void container_free(struct module* container);
+void sort_module(struct module* current);
+
+void inputs_to_sources(
+	struct input inputs[],
+	int n_inputs,
+	struct source sources[]
+);
+
+#endif // ifndef INPUT_H
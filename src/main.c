@@ -1,16 +1,24 @@
-#include <ctype.h>
-#include <dirent.h>
-#include <limits.h>
+#include <errno.h>
+#include <getopt.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "batch.h"
+#include "check.h"
 #include "generate.h"
+#include "input.h"
+#include "object.h"
 #include "parse.h"
+#include "serve.h"
+#include "symbols.h"
 #include "util.h"
+#include "watch.h"
 
 #ifndef NAME
 #define NAME    "nasal-docgen"
@@ -20,24 +28,34 @@
 extern char* optarg;
 extern int optind, optopt;
 
-int argc;
-char* const* argv;
-
-struct input {
-	char* file;
-	char* absolute;
-	char* module;
-};
+static int argc;
+static char* const* argv;
 
 struct options {
 	struct generate_options generate;
 	const char *desc;
+	const char *serve;
+	const char *batch;
+	char **entry;
+	char **link_with;
+	bool watch;
+	bool check;
+	bool low_memory;
+	bool compile;
 };
 
 int parse_options(struct options* options);
-int parse_inputs(struct input inputs[], int* n_inputs);
-int resolve_inputs(struct input inputs[], int n_inputs);
-int process_inputs(struct input inputs[], int n_inputs, struct options opts);
+int process_inputs(
+	struct input inputs[],
+	int n_inputs,
+	struct module* parsed[],
+	struct options opts
+);
+int compile_input(char* const args[], int n_args, const char* output);
+int watch_inputs(struct input inputs[], int n_inputs, struct options opts);
+int serve_inputs(struct input inputs[], int n_inputs, struct options opts);
+int check_inputs(struct input inputs[], int n_inputs, char* tables[]);
+int stream_inputs(struct input inputs[], int n_inputs, struct options opts);
 
 int main(int _argc, char* const _argv[]) {
 	argc = _argc;
@@ -48,20 +66,141 @@ int main(int _argc, char* const _argv[]) {
 		argc = 1;
 	}
 
+	set_program_name(argv[0]);
+
+	// -MD takes a value like a short option but is not one, so it is given to
+	// getopt in the long form
+	char* args[argc + 1];
+	for (int i = 0; i < argc; i++) {
+		if (strcmp(argv[i], "--") == 0) {
+			memcpy(args + i, argv + i, (argc - i) * sizeof(char*));
+			break;
+		}
+
+		bool depfile = strncmp(argv[i], "-MD", 3) == 0;
+		if (depfile && (argv[i][3] == 0 || argv[i][3] == '='))
+			args[i] = asprintf("-%s", argv[i]);
+		else
+			args[i] = argv[i];
+	}
+
+	args[argc] = NULL;
+	argv = args;
+
 	struct options options = { 0 };
 	if (parse_options(&options)) return 1;
 
+	if (options.compile)
+		return compile_input(argv + optind, argc - optind, options.generate.output);
+
 	if (!options.desc) options.desc = "";
 	if (!options.generate.library) options.generate.library = "globals";
 	if (!options.generate.output) options.generate.output = "docs";
 
-	struct input inputs[1024] = {};
-	int n_inputs = argc - optind;
+	// --low-memory never holds the whole library, which these need
+	if (options.low_memory && options.generate.depfile) {
+		fprintf(stderr, "%s: -MD cannot be used with --low-memory\n", argv[0]);
+		return 1;
+	}
+
+	if (options.low_memory && (options.generate.formats & ~FORMAT_HTML)) {
+		fprintf(stderr, "%s: -f can only be html with --low-memory\n", argv[0]);
+		return 1;
+	}
+
+	if (options.low_memory && options.generate.symbols) {
+		fprintf(
+			stderr, "%s: --symbols cannot be used with --low-memory\n", argv[0]
+		);
+		return 1;
+	}
 
-	if (parse_inputs(inputs, &n_inputs) == -1) return 1;
-	if (resolve_inputs(inputs, n_inputs) == -1) return 2;
+	if (options.low_memory && options.generate.model) {
+		fprintf(
+			stderr, "%s: --emit-model cannot be used with --low-memory\n", argv[0]
+		);
+		return 1;
+	}
+
+	if (options.low_memory && options.generate.themes) {
+		fprintf(stderr, "%s: --theme cannot be used with --low-memory\n", argv[0]);
+		return 1;
+	}
+
+	if (options.low_memory && options.generate.spa) {
+		fprintf(stderr, "%s: --spa cannot be used with --low-memory\n", argv[0]);
+		return 1;
+	}
+
+	if (options.low_memory && options.generate.only) {
+		fprintf(stderr, "%s: --only cannot be used with --low-memory\n", argv[0]);
+		return 1;
+	}
+
+	// the tables are only used to resolve the references which are checked
+	if (options.link_with && !options.check) {
+		fprintf(stderr, "%s: --link-with requires --check\n", argv[0]);
+		return 1;
+	}
+
+	if (options.batch) {
+		if (optind < argc) {
+			fprintf(stderr, "%s: --batch does not take FILE(s)\n", argv[0]);
+			return 1;
+		}
+
+		// these write one file or listing for a single library
+		const char* single =
+			options.generate.manifest ? "--manifest" :
+			options.generate.depfile ? "-MD" :
+			options.generate.symbols ? "--symbols" :
+			options.generate.model ? "--emit-model" :
+			options.generate.themes ? "--theme" : NULL;
+
+		if (single) {
+			fprintf(
+				stderr, "%s: %s cannot be used with --batch\n", argv[0], single
+			);
+			return 1;
+		}
 
-	return process_inputs(inputs, n_inputs, options);
+		return run_batch(options.batch, options.generate);
+	}
+
+	struct input inputs[MAX_INPUTS] = {};
+	int n_inputs;
+
+	if (options.entry) {
+		if (optind < argc) {
+			fprintf(stderr, "%s: --entry does not take FILE(s)\n", argv[0]);
+			return 1;
+		}
+
+		int n_entries = 0;
+		while (options.entry[n_entries]) n_entries++;
+
+		struct module** parsed = calloc(MAX_INPUTS, sizeof(struct module*));
+		int ret = reach_inputs(options.entry, n_entries, inputs, &n_inputs, parsed);
+		if (ret > 0) return ret;
+
+		// the other modes parse the files themselves
+		bool reparse =
+			options.check || options.serve || options.watch || options.low_memory;
+		if (!reparse) return process_inputs(inputs, n_inputs, parsed, options);
+
+		for (int i = 0; i < n_inputs; i++) module_free(parsed[i]);
+		free(parsed);
+	} else {
+		if (parse_inputs(argv + optind, argc - optind, inputs, &n_inputs) == -1)
+			return 1;
+		if (resolve_inputs(inputs, n_inputs) == -1) return 2;
+	}
+
+	if (options.check) return check_inputs(inputs, n_inputs, options.link_with);
+	if (options.serve) return serve_inputs(inputs, n_inputs, options);
+	if (options.watch) return watch_inputs(inputs, n_inputs, options);
+	if (options.low_memory) return stream_inputs(inputs, n_inputs, options);
+	return process_inputs(inputs, n_inputs, NULL, options);
 }
 
 #define OPTION_VALUE(flag, name) {                                             \
@@ -76,10 +215,104 @@ int main(int _argc, char* const _argv[]) {
 	if (options->name[0] == '=') options->name++;                                \
 }
 
+enum long_option {
+	OPTION_AGGREGATE = 0x100,
+	OPTION_BATCH,
+	OPTION_CHECK,
+	OPTION_DEPFILE,
+	OPTION_EMIT_MODEL,
+	OPTION_ENTRY,
+	OPTION_FULL_TEXT,
+	OPTION_HASH_STATICS,
+	OPTION_LINK_WITH,
+	OPTION_LOW_MEMORY,
+	OPTION_MANIFEST,
+	OPTION_MINIFY,
+	OPTION_NDJSON,
+	OPTION_ONLY,
+	OPTION_PRECOMPRESS,
+	OPTION_SHARD_LIST,
+	OPTION_SPA,
+	OPTION_STATIC_STORE,
+	OPTION_SYMBOLS,
+	OPTION_THEME,
+	OPTION_WITH_LIST,
+	OPTION_WITH_SOURCES,
+};
+
+static const struct option long_options[] = {
+	{ "aggregate", no_argument, NULL, OPTION_AGGREGATE },
+	{ "batch", required_argument, NULL, OPTION_BATCH },
+	{ "check", no_argument, NULL, OPTION_CHECK },
+	{ "emit-model", required_argument, NULL, OPTION_EMIT_MODEL },
+	{ "entry", required_argument, NULL, OPTION_ENTRY },
+	{ "full-text", no_argument, NULL, OPTION_FULL_TEXT },
+	{ "hash-statics", no_argument, NULL, OPTION_HASH_STATICS },
+	{ "MD", required_argument, NULL, OPTION_DEPFILE },
+	{ "link-with", required_argument, NULL, OPTION_LINK_WITH },
+	{ "low-memory", no_argument, NULL, OPTION_LOW_MEMORY },
+	{ "manifest", no_argument, NULL, OPTION_MANIFEST },
+	{ "minify", no_argument, NULL, OPTION_MINIFY },
+	{ "ndjson", no_argument, NULL, OPTION_NDJSON },
+	{ "only", required_argument, NULL, OPTION_ONLY },
+	{ "precompress", no_argument, NULL, OPTION_PRECOMPRESS },
+	{ "serve", required_argument, NULL, 's' },
+	{ "shard-list", no_argument, NULL, OPTION_SHARD_LIST },
+	{ "spa", no_argument, NULL, OPTION_SPA },
+	{ "static-store", required_argument, NULL, OPTION_STATIC_STORE },
+	{ "symbols", required_argument, NULL, OPTION_SYMBOLS },
+	{ "theme", required_argument, NULL, OPTION_THEME },
+	{ "watch", no_argument, NULL, 'w' },
+	{ "with-list", no_argument, NULL, OPTION_WITH_LIST },
+	{ "with-sources", no_argument, NULL, OPTION_WITH_SOURCES },
+	{ 0 },
+};
+
+static int parse_formats(const char* list, struct options* options) {
+	static const struct {
+		const char* name;
+		enum output_format format;
+	} formats[] = {
+		{ "html", FORMAT_HTML },
+		{ "json", FORMAT_JSON },
+		{ "markdown", FORMAT_MARKDOWN },
+		{ "man", FORMAT_MAN },
+	};
+
+	for (const char* name = list; ; name++) {
+		size_t length = strcspn(name, ",");
+
+		size_t i = 0;
+		for (; i < sizeof(formats) / sizeof(formats[0]); i++) {
+			const char* format = formats[i].name;
+			if (strlen(format) == length && strncmp(format, name, length) == 0)
+				break;
+		}
+
+		if (i == sizeof(formats) / sizeof(formats[0])) {
+			fprintf(
+				stderr, "%s: '%.*s' is not a format\n", argv[0], (int) length, name
+			);
+			return 1;
+		}
+
+		options->generate.formats |= formats[i].format;
+
+		name += length;
+		if (!*name) break;
+	}
+
+	return 0;
+}
+
 int parse_options(struct options* options) {
 	int lastopt;
-	while ((lastopt = getopt(argc, argv, ":d:hno:r:t:v")) != -1) {
-		switch ((char) lastopt) {
+	const char* short_options = ":cd:f:hno:r:s:t:vw";
+	while (
+		(lastopt = getopt_long(argc, argv, short_options, long_options, NULL))
+			!= -1
+	) {
+		switch (lastopt) {
 			case 'h':
 				printf("Usage: %s [OPTION]... [FILE]...\n", argv[0]);
 				puts("Generate documentation for FILE(s).");
@@ -88,13 +321,62 @@ int parse_options(struct options* options) {
 				puts("");
 
 				puts("These OPTIONs are available:");
+				puts("  --aggregate    document variables and functions on the page");
+				puts("                 of their namespace or class");
+				puts("  --batch=MANIFEST");
+				puts("                 document each library listed in MANIFEST");
+				puts("  -c             compile FILE to an object, which can later be");
+				puts("                 given as a FILE (OUTPUT defaults to FILE.ndo)");
+				puts("  --check        check FILE(s) without generating anything");
 				puts("  -d=DESC        set description of library");
+				puts("  --emit-model=FILE");
+				puts("                 write a JSON model of the library to FILE");
+				puts("  --entry=FILE   only document FILE and the files it loads");
+				puts("                 (may be repeated)");
+				puts("  -f=FORMATS     output each of the comma-separated FORMATS, of");
+				puts("                 html, json, markdown and man (default html)");
+				puts("  --full-text    also index the descriptions for searching");
 				puts("  -h             print help information");
+				puts("  --hash-statics");
+				puts("                 name the static files by a hash of their");
+				puts("                 contents, so they can be cached forever");
+				puts("  --link-with=TABLE");
+				puts("                 resolve class names with --check against the");
+				puts("                 symbol TABLE of another library");
+				puts("                 (may be repeated)");
+				puts("  --low-memory   document one top-level module at a time");
+				puts("  --manifest     list the output files in OUTPUT/.manifest,");
+				puts("                 print those added, changed and removed since");
+				puts("                 the last run, and delete the removed ones");
+				puts("  -MD=FILE       write the dependencies of the output to FILE");
+				puts("  --minify       strip comments and indentation from the pages");
 				puts("  -n             disable markdown rendering");
+				puts("  --ndjson       write the --emit-model model with one module");
+				puts("                 or item per line");
 				puts("  -o=OUTPUT      output to directory OUTPUT");
+				puts("  --only=PATH    only document the module or item at PATH");
+				puts("                 (may be repeated)");
+				puts("  --precompress  also write each file compressed, beside it");
 				puts("  -r=NAME        set name of library");
+				puts("  -s, --serve=ADDR");
+				puts("                 serve documentation over HTTP on ADDR");
+				puts("  --shard-list   split the item list into a page for each");
+				puts("                 top-level namespace, and an index");
+				puts("  --spa          output one page which fetches the data of each");
+				puts("                 namespace and class as it is shown");
+				puts("  --static-store=DIR");
+				puts("                 hard link the static files from DIR, which");
+				puts("                 can be shared by many outputs");
+				puts("  --symbols=TABLE");
+				puts("                 write a symbol table of the library to TABLE");
 				puts("  -t=TEMPLATE    use documentation template from TEMPLATE");
+				puts("  --theme=TEMPLATE");
+				puts("                 also output html from TEMPLATE, to a directory");
+				puts("                 of OUTPUT named after it (may be repeated)");
 				puts("  -v             print version information");
+				puts("  -w, --watch    regenerate when inputs or template change");
+				puts("  --with-list    also generate the item list with --only");
+				puts("  --with-sources also generate the source pages with --only");
 
 				puts("");
 
@@ -113,10 +395,18 @@ int parse_options(struct options* options) {
 
 				return 0;
 
+			case 'c':
+				options->compile = true;
+				break;
+
 			case 'd':
 				OPTION_VALUE("-d", desc);
 				break;
 
+			case 'f':
+				if (parse_formats(optarg + (optarg[0] == '='), options) > 0) return 1;
+				break;
+
 			case 'n':
 				options->generate.no_markdown = true;
 				break;
@@ -129,16 +419,161 @@ int parse_options(struct options* options) {
 				OPTION_VALUE("-r", generate.library);
 				break;
 
+			case 's':
+				OPTION_VALUE("--serve", serve);
+				break;
+
 			case 't':
 				OPTION_VALUE("-t", generate.template);
 				break;
 
+			case 'w':
+				options->watch = true;
+				options->generate.memoise = true;
+				options->generate.incremental = true;
+				break;
+
+			case OPTION_AGGREGATE:
+				options->generate.aggregate = true;
+				break;
+
+			case OPTION_BATCH:
+				OPTION_VALUE("--batch", batch);
+				break;
+
+			case OPTION_CHECK:
+				options->check = true;
+				break;
+
+			case OPTION_DEPFILE:
+				OPTION_VALUE("-MD", generate.depfile);
+				break;
+
+			case OPTION_EMIT_MODEL:
+				OPTION_VALUE("--emit-model", generate.model);
+				break;
+
+			case OPTION_ENTRY: {}
+				int n_entries = 0;
+				if (options->entry) while (options->entry[n_entries]) n_entries++;
+
+				options->entry = realloc(
+					options->entry, (n_entries + 2) * sizeof(char*)
+				);
+				options->entry[n_entries] = optarg + (optarg[0] == '=');
+				options->entry[n_entries + 1] = NULL;
+
+				break;
+
+			case OPTION_FULL_TEXT:
+				options->generate.full_text = true;
+				break;
+
+			case OPTION_HASH_STATICS:
+				options->generate.hash_statics = true;
+				break;
+
+			case OPTION_LINK_WITH: {}
+				int n_tables = 0;
+				if (options->link_with)
+					while (options->link_with[n_tables]) n_tables++;
+
+				options->link_with = realloc(
+					options->link_with, (n_tables + 2) * sizeof(char*)
+				);
+				options->link_with[n_tables] = optarg + (optarg[0] == '=');
+				options->link_with[n_tables + 1] = NULL;
+
+				break;
+
+			case OPTION_LOW_MEMORY:
+				options->low_memory = true;
+				break;
+
+			case OPTION_MANIFEST:
+				options->generate.manifest = true;
+				break;
+
+			case OPTION_MINIFY:
+				options->generate.minify = true;
+				break;
+
+			case OPTION_NDJSON:
+				options->generate.model_lines = true;
+				break;
+
+			case OPTION_ONLY: {}
+				int n_only = 0;
+				if (options->generate.only)
+					while (options->generate.only[n_only]) n_only++;
+
+				options->generate.only = realloc(
+					options->generate.only, (n_only + 2) * sizeof(const char*)
+				);
+				options->generate.only[n_only] = optarg + (optarg[0] == '=');
+				options->generate.only[n_only + 1] = NULL;
+
+				break;
+
+			case OPTION_PRECOMPRESS:
+				options->generate.precompress = true;
+				break;
+
+			case OPTION_SHARD_LIST:
+				options->generate.shard_list = true;
+				break;
+
+			case OPTION_SPA:
+				options->generate.spa = true;
+				break;
+
+			case OPTION_STATIC_STORE:
+				OPTION_VALUE("--static-store", generate.static_store);
+				break;
+
+			case OPTION_SYMBOLS:
+				OPTION_VALUE("--symbols", generate.symbols);
+				break;
+
+			case OPTION_THEME: {}
+				int n_themes = 0;
+				if (options->generate.themes)
+					while (options->generate.themes[n_themes]) n_themes++;
+
+				options->generate.themes = realloc(
+					options->generate.themes, (n_themes + 2) * sizeof(const char*)
+				);
+				options->generate.themes[n_themes] = optarg + (optarg[0] == '=');
+				options->generate.themes[n_themes + 1] = NULL;
+
+				break;
+
+			case OPTION_WITH_LIST:
+				options->generate.only_list = true;
+				break;
+
+			case OPTION_WITH_SOURCES:
+				options->generate.only_sources = true;
+				break;
+
 			case ':':
-				fprintf(stderr, "%s: -%c requires a value\n", argv[0], (char) optopt);
+				if (optopt < 0x80) {
+					fprintf(stderr, "%s: -%c requires a value\n", argv[0], (char) optopt);
+				} else {
+					const char* option = argv[optind - 1];
+					fprintf(stderr, "%s: %s requires a value\n", argv[0], option);
+				}
+
 				return 1;
 
 			case '?':
-				fprintf(stderr, "%s: -%c is not an option\n", argv[0], (char) optopt);
+				if (optopt != 0) {
+					fprintf(stderr, "%s: -%c is not an option\n", argv[0], (char) optopt);
+				} else {
+					const char* option = argv[optind - 1];
+					fprintf(stderr, "%s: %s is not an option\n", argv[0], option);
+				}
+
 				return 1;
 		}
 	}
@@ -146,260 +581,353 @@ int parse_options(struct options* options) {
 	return 0;
 }
 
-char buf[PATH_MAX] = { '.', '/', 0 };
-int buflen = 2;
+int process_inputs(
+	struct input inputs[],
+	int n_inputs,
+	struct module* parsed[],
+	struct options opts
+) {
+	struct module* fragments[n_inputs + 1];
 
-void search_dir(struct input inputs[], int* n_inputs) {
-	DIR* dir = opendir(buf);
-	if (dir == NULL) return;
+	for (int i = 0; i < n_inputs; i++) {
+		if (parsed != NULL) {
+			fragments[i] = parsed[i];
+			continue;
+		}
 
-	struct dirent* dir_item;
-	while ((dir_item = readdir(dir))) {
-		if (strcmp(dir_item->d_name, ".") == 0) continue;
-		if (strcmp(dir_item->d_name, "..") == 0) continue;
+		int ret = parse_input(&inputs[i], &fragments[i]);
+		if (ret > 0) return ret;
+	}
 
-		strcpy(buf + buflen, dir_item->d_name);
+	struct list* containers = list_new();
+	struct module* root =
+		assemble_tree(inputs, fragments, n_inputs, opts.desc, containers);
 
-		int buflen_before = buflen;
-		buflen += strlen(dir_item->d_name);
+	struct source sources[n_inputs + 1];
+	inputs_to_sources(inputs, n_inputs, sources);
 
-		if (dir_item->d_type == DT_DIR) {
-			buf[buflen] = '/';
-			buflen += 1;
-			buf[buflen] = 0;
+	int ret = generate_docs(root, sources, opts.generate);
 
-			search_dir(inputs, n_inputs);
-		} else if (strcmp(buf + buflen - 4, ".nas") == 0) {
-			char* buf_clone = malloc(buflen - 1);
-			strcpy(buf_clone, buf + 2);
+	list_free(containers, (void (*)(void*)) container_free);
 
-			inputs[(*n_inputs)++] = (struct input) {
-				.file = buf_clone,
-				.module = NULL
-			};
-		}
+	return ret;
+}
 
-		buf[buflen_before] = 0;
-		buflen = buflen_before;
+// parses a single file into a compiled object, so that parsing can be done
+// separately (and in parallel) from generation
+int compile_input(char* const args[], int n_args, const char* output) {
+	if (n_args != 1) {
+		fprintf(stderr, "%s: -c takes exactly one FILE\n", argv[0]);
+		return 1;
 	}
 
-	closedir(dir);
-}
+	struct input input;
+	int n_inputs;
+	if (parse_inputs(args, 1, &input, &n_inputs) == -1) return 1;
 
-int parse_inputs(struct input inputs[], int* n_inputs) {
-	for (int i = optind; i < argc; i++) {
-		const char* module = strrchr(argv[i], ':');
-
-		if (module == NULL) {
-			inputs[i - optind] = (struct input) {
-				.file = argv[i],
-				.module = NULL
-			};
-		} else {
-			char* file_clone = malloc(module - argv[i] + 1);
-			strncpy(file_clone, argv[i], module - argv[i]);
-			file_clone[module - argv[i]] = 0;
-
-			size_t module_len = argv[i] + strlen(argv[i]) - module - 1;
-			char* module_clone = malloc(module_len + 1);
-			strncpy(module_clone, module + 1, module_len);
-			module_clone[module_len] = 0;
-
-			inputs[i - optind] = (struct input) {
-				.file = file_clone,
-				.module = module_clone + (module_clone[0] == '.' ? 1 : 0)
-			};
-
-			bool last_was_dot = false;
-			for (int j = 1; j < module_len + 1; j++) {
-				if (module[j] == '.') {
-					if (last_was_dot || (j == module_len && j > 1)) {
-						fprintf(stderr, "%s: '%s' is invalid\n", argv[0], module + 1);
-						return -1;
-					}
-
-					last_was_dot = true;
-				} else {
-					if (!isalnum(module[j]) && module[j] != '_') {
-						fprintf(stderr, "%s: '%s' is invalid\n", argv[0], module + 1);
-						return -1;
-					}
+	char* object;
+	if (output) {
+		object = astrndup(output, strlen(output));
+	} else {
+		size_t length = strlen(input.file);
+		if (length >= 4 && strcmp(input.file + length - 4, ".nas") == 0)
+			length -= 4;
 
-					last_was_dot = false;
-				}
-			}
-		}
+		object = asprintf("%.*s.ndo", (int) length, input.file);
 	}
 
-	if (*n_inputs == 0) {
-		search_dir(inputs, n_inputs);
+	struct module* fragment;
+	int ret = parse_input(&input, &fragment);
+
+	if (ret == 0) {
+		ret = write_object(object, input.file, input.module, fragment);
+		module_free(fragment);
 	}
 
-	return 0;
+	free(object);
+	input_free(&input);
+
+	return ret;
 }
 
-int resolve_inputs(struct input inputs[], int n_inputs) {
-	char* common = NULL;
-	char* segments[64] = { 0 };
-	int n_segments = 0;
+static struct item* summarise_item(struct item* item) {
+	struct item* summary = calloc(1, sizeof(struct item));
+	summary->filename = item->filename;
+	summary->line = item->line;
+	summary->name = astrndup(item->name, strlen(item->name));
+	summary->type = item->type;
+
+	if (item->type == ITEM_FUNC) {
+		summary->items = list_new();
+	} else if (item->type == ITEM_CLASS) {
+		summary->items = list_new();
+		LIST_ITER_T(item->items, child, struct item*)
+			list_push(summary->items, summarise_item(child));
+	}
 
-	for (int i = 0; i < n_inputs; i++) {
-		if (inputs[i].module == NULL) {
-			char* resolved = realpath(inputs[i].file, NULL);
+	return summary;
+}
 
-			if (resolved == NULL) {
-				perrorf("failed to resolve '%s'", inputs[i].file);
-				return -1;
-			}
+// copies only what is needed for the item list and the root page, which is the
+// names throughout and the description of the module itself
+static struct module* summarise_module(struct module* module, bool desc) {
+	struct module* summary = calloc(1, sizeof(struct module));
+	summary->filename = module->filename;
+	summary->line = module->line;
+	summary->name = astrndup(module->name, strlen(module->name));
+	summary->children = list_new();
+	summary->items = list_new();
+
+	if (desc && module->desc)
+		summary->desc = astrndup(module->desc, strlen(module->desc));
+
+	LIST_ITER_T(module->children, child, struct module*)
+		list_push(summary->children, summarise_module(child, false));
+	LIST_ITER_T(module->items, item, struct item*)
+		list_push(summary->items, summarise_item(item));
+
+	return summary;
+}
+
+// documents the inputs one top-level module at a time, freeing each before
+// moving on, so that only the largest of them (and a summary of the rest) has
+// to be in memory at once
+int stream_inputs(struct input inputs[], int n_inputs, struct options opts) {
+	int ret;
+	struct generator* gen = generator_new(opts.generate, &ret);
+	if (gen == NULL) return ret;
+
+	struct module root = {
+		.name = "",
+		.desc = (char*) opts.desc,
+		.children = list_new(),
+		.items = list_new(),
+	};
 
-			resolved[0] = 0;
+	bool done[n_inputs + 1];
+	for (int i = 0; i < n_inputs; i++) done[i] = false;
 
-			char* current = resolved + 1;
-			char* last_current = current;
-			int current_n = 0;
+	for (int i = 0; i < n_inputs && ret == 0; i++) {
+		if (done[i]) continue;
 
-			if (common == NULL) segments[n_segments++] = current;
+		size_t length = strcspn(inputs[i].module, ".");
 
-			while ((current = strchr(current, '/')) != NULL) {
-				current[0] = 0;
-				current += 1;
+		struct input group[n_inputs + 1];
+		struct module* fragments[n_inputs + 1];
+		int n_group = 0;
 
-				if (common == NULL) {
-					segments[n_segments++] = current;
-				} else if (
-					n_segments <= current_n ||
-					strcmp(segments[current_n], last_current) != 0
-				) {
-					n_segments = current_n;
-					break;
-				} else {
-					current_n++;
-				}
+		for (int j = i; j < n_inputs && ret == 0; j++) {
+			if (
+				done[j] ||
+				strncmp(inputs[i].module, inputs[j].module, length) ||
+				strcspn(inputs[j].module, ".") != length
+			) continue;
 
-				last_current = current;
-			}
+			done[j] = true;
+			group[n_group] = inputs[j];
+			ret = parse_input(&inputs[j], &fragments[n_group]);
+			if (ret == 0) n_group++;
+		}
 
-			if (common == NULL) {
-				n_segments -= 1;
-				common = resolved;
-			} else {
-				if (current_n < n_segments) n_segments = current_n;
+		if (ret == 0) {
+			struct list* containers = list_new();
+			struct module* subtree =
+				assemble_tree(group, fragments, n_group, "", containers);
+			struct module* module = list_get(subtree->children, 0);
 
-				free(resolved);
-			}
+			list_push(root.children, summarise_module(module, true));
+			ret = generator_run_module(gen, module);
+
+			list_free(containers, (void (*)(void*)) container_free);
 		}
+
+		for (int j = 0; j < n_group; j++) module_free(fragments[j]);
 	}
 
-	int prefix = 1 + n_segments;
-	for (int i = 0; i < n_segments; i++)
-		prefix += strlen(segments[i]);
+	if (ret == 0) {
+		sort_module(&root);
 
-	free(common);
+		struct source sources[n_inputs + 1];
+		inputs_to_sources(inputs, n_inputs, sources);
 
-	for (int i = 0; i < n_inputs; i++) {
-		if (inputs[i].module == NULL) {
-			char* resolved = realpath(inputs[i].file, NULL) + prefix;
-			int resolved_len = strlen(resolved);
+		ret = generator_run_index(gen, &root, sources);
+	}
 
-			inputs[i].absolute = astrndup(resolved, resolved_len);
+	list_free(root.children, (void (*)(void*)) module_free);
+	list_free(root.items, NULL);
+	generator_free(gen);
 
-			if (strcmp(resolved + resolved_len - 4, ".nas") == 0)
-				resolved[resolved_len - 4] = 0;
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+		errorf("peak memory usage: %ld KiB\n", usage.ru_maxrss);
 
-			for (int j = 0; resolved[j]; j++) {
-				if (resolved[j] == '/')
-					resolved[j] = '.';
-				else if (!isalnum(resolved[j]) && resolved[j] != '_')
-					resolved[j] = '_';
-			}
+	return ret;
+}
 
-			inputs[i].module = resolved;
+int check_inputs(struct input inputs[], int n_inputs, char* tables[]) {
+	struct source sources[n_inputs + 1];
+	inputs_to_sources(inputs, n_inputs, sources);
+
+	if (tables == NULL) return check_sources(sources, NULL);
+
+	int n_tables = 0;
+	while (tables[n_tables]) n_tables++;
+
+	struct symbols* opened[n_tables + 1];
+	int ret = 0;
+
+	for (int i = 0; i < n_tables; i++) {
+		if (!(opened[i] = symbols_open(tables[i]))) {
+			ret = 2;
+			n_tables = i;
+			break;
 		}
 	}
 
-	return 0;
-}
+	opened[n_tables] = NULL;
 
-void* filter_name_eq(void* item, void* compare) {
-	return strcmp(((struct module*) item)->name, compare) == 0 ? item : NULL;
+	if (ret == 0) ret = check_sources(sources, opened);
+
+	for (int i = 0; i < n_tables; i++) symbols_close(opened[i]);
+
+	return ret;
 }
 
-struct module* find_or_create_module(struct module* current, char* segment) {
-	struct module* select = list_iter(current->children, filter_name_eq, segment);
-	if (select == NULL) {
-		select = calloc(1, sizeof(struct module));
-		select->name = segment;
-		select->children = list_new();
-		select->items = list_new();
+int serve_inputs(struct input inputs[], int n_inputs, struct options opts) {
+	struct module* fragments[n_inputs + 1];
 
-		list_push(current->children, select);
+	for (int i = 0; i < n_inputs; i++) {
+		int ret = parse_input(&inputs[i], &fragments[i]);
+		if (ret > 0) return ret;
 	}
 
-	return select;
-}
+	struct list* containers = list_new();
+	struct module* root =
+		assemble_tree(inputs, fragments, n_inputs, opts.desc, containers);
 
-int comp_module(const struct module** a, const struct module** b) {
-	return strcmp((*a)->name, (*b)->name);
-}
+	struct source sources[n_inputs + 1];
+	inputs_to_sources(inputs, n_inputs, sources);
 
-int comp_item(const struct item** a, const struct item** b) {
-	return strcmp((*a)->name, (*b)->name);
-}
+	int ret;
+	struct generator* gen = generator_new(opts.generate, &ret);
 
-void sort_items(struct list* items) {
-	list_sort(items, (int (*)(const void*, const void*)) comp_item);
-	LIST_ITER_T(items, item, struct item*) {
-		if (item->type == ITEM_CLASS) sort_items(item->items);
+	if (gen != NULL) {
+		ret = serve(opts.serve, gen, root, sources);
+		generator_free(gen);
 	}
+
+	list_free(containers, (void (*)(void*)) container_free);
+
+	return ret;
 }
 
-void sort_module(struct module* current) {
-	list_sort(current->children, (int (*)(const void*, const void*)) comp_module);
-	LIST_ITER_T(current->children, child, struct module*) {
-		sort_module(child);
-	}
+#define TEMPLATE_ID (-1)
+
+static double elapsed_ms(struct timespec* start) {
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
 
-	sort_items(current->items);
+	return (end.tv_sec - start->tv_sec) * 1e3 +
+		(end.tv_nsec - start->tv_nsec) / 1e6;
 }
 
-int process_inputs(struct input inputs[], int n_inputs, struct options opts) {
-	struct module root = {
-		.filename = NULL,
-		.name = "",
-		.desc = (char *) opts.desc,
-		.children = list_new(),
-		.items = list_new(),
-	};
+int watch_inputs(struct input inputs[], int n_inputs, struct options opts) {
+	struct module* fragments[n_inputs + 1];
 
 	for (int i = 0; i < n_inputs; i++) {
-		struct module* current = &root;
-		const char* segment = inputs[i].module;
-		char* next_segment;
+		int ret = parse_input(&inputs[i], &fragments[i]);
+		if (ret > 0) return ret;
+	}
 
-		while ((next_segment = strchr(segment, '.')) != NULL) {
-			next_segment[0] = 0;
+	struct source sources[n_inputs + 1];
+	inputs_to_sources(inputs, n_inputs, sources);
+
+	int changed[n_inputs + 1];
+	int n_changed;
+
+	int ret;
+	struct generator* gen = generator_new(opts.generate, &ret);
+	if (gen == NULL) return ret;
+
+	struct list* containers = list_new();
+	struct module* root =
+		assemble_tree(inputs, fragments, n_inputs, opts.desc, containers);
+
+	if ((ret = generator_run(gen, root, sources)) > 0) goto end;
+
+	struct watcher* watcher = watcher_new();
+	if (watcher == NULL) {
+		ret = 2;
+		goto end;
+	}
 
-			current = find_or_create_module(current, (char*) segment);
-			segment = next_segment + 1;
+	for (int i = 0; i < n_inputs; i++) {
+		if (watcher_add_file(watcher, inputs[i].file, i) == -1) {
+			ret = 2;
+			goto end_watch;
 		}
+	}
 
-		current = find_or_create_module(current, (char*) segment);
-		current->filename = inputs[i].absolute;
-		current->line = 1;
+	static const char* template_dirs[] = { "", "/pages", "/static" };
+	for (int i = 0; i < 3; i++) {
+		char* path = asprintf("%s%s", generator_template(gen), template_dirs[i]);
 
-		int ret = parse_file(inputs[i].file, inputs[i].absolute, current);
-		if (ret > 0) return ret;
+		// a template need not have static files, but anything else which cannot
+		// be watched would leave the docs silently out of date
+		int added = 0;
+		if (i != 2 || access(path, F_OK) == 0 || errno != ENOENT)
+			added = watcher_add_dir(watcher, path, TEMPLATE_ID);
+		free(path);
+
+		if (added == -1) {
+			ret = 2;
+			goto end_watch;
+		}
 	}
 
-	sort_module(&root);
+	errorf("watching %d files for changes\n", n_inputs);
 
-	struct source sources[n_inputs + 1];
-	sources[n_inputs].file = NULL;
+	while ((n_changed = watcher_wait(watcher, changed, n_inputs + 1)) > 0) {
+		struct timespec start;
+		clock_gettime(CLOCK_MONOTONIC, &start);
 
-	for (int i = 0; i < n_inputs; i++) {
-		sources[i].file = inputs[i].file;
-		sources[i].alias = inputs[i].absolute;
+		bool failed = false;
+
+		for (int i = 0; i < n_changed; i++) {
+			if (changed[i] == TEMPLATE_ID) {
+				if (generator_reload(gen) > 0) failed = true;
+				continue;
+			}
+
+			// on failure the previous parse is kept, so the docs stay usable
+			struct module* fragment;
+			if (parse_input(&inputs[changed[i]], &fragment) > 0) {
+				failed = true;
+				continue;
+			}
+
+			module_free(fragments[changed[i]]);
+			fragments[changed[i]] = fragment;
+		}
+
+		if (failed) continue;
+
+		list_free(containers, (void (*)(void*)) container_free);
+		containers = list_new();
+		root = assemble_tree(inputs, fragments, n_inputs, opts.desc, containers);
+
+		if (generator_run(gen, root, sources) > 0) continue;
+
+		errorf("regenerated in %.1f ms\n", elapsed_ms(&start));
 	}
 
-	return generate_docs(&root, sources, opts.generate);
+	ret = n_changed == -1 ? 2 : 0;
+
+end_watch:
+	watcher_free(watcher);
+end:
+	list_free(containers, (void (*)(void*)) container_free);
+	generator_free(gen);
+
+	return ret;
 }
@@ -0,0 +1,278 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "manifest.h"
+#include "util.h"
+
+/*
+	a manifest lists the path, hash and size of each file written to an output
+	dir, and is kept in the dir as .manifest; when a run finishes, its files are
+	compared with those of the run before to report which were added, changed
+	and removed, and the files no longer written are deleted
+*/
+
+struct manifest_entry {
+	uint64_t hash;
+	size_t size;
+	bool kept; /* not written by this run, but still current */
+};
+
+struct manifest {
+	struct map* entries; /* path -> manifest_entry, or NULL once dropped */
+};
+
+struct manifest* manifest_new() {
+	struct manifest* manifest = malloc(sizeof(struct manifest));
+	manifest->entries = map_new();
+
+	return manifest;
+}
+
+void manifest_free(struct manifest* manifest) {
+	if (manifest == NULL) return;
+
+	map_free(manifest->entries, free);
+	free(manifest);
+}
+
+void manifest_clear(struct manifest* manifest) {
+	map_free(manifest->entries, free);
+	manifest->entries = map_new();
+}
+
+void manifest_add(
+	struct manifest* manifest,
+	const char* path,
+	const char* data,
+	size_t length
+) {
+	struct manifest_entry* entry = malloc(sizeof(struct manifest_entry));
+	*entry = (struct manifest_entry) { hash_bytes(data, length, 0), length };
+
+	free(map_set(manifest->entries, path, entry));
+}
+
+// records a file which was left as it was, such as a page whose input has not
+// changed; its hash is taken from the last manifest when finishing
+void manifest_keep(struct manifest* manifest, const char* path) {
+	if (map_get(manifest->entries, path)) return;
+
+	struct manifest_entry* entry = calloc(1, sizeof(struct manifest_entry));
+	entry->kept = true;
+
+	map_set(manifest->entries, path, entry);
+}
+
+static struct map* load_manifest(int dir_fd) {
+	struct map* entries = map_new();
+
+	int fd = openat(dir_fd, MANIFEST_FILE, O_RDONLY);
+	if (fd == -1) {
+		if (errno == ENOENT) return entries;
+
+		perrorf("failed to open '%s'", MANIFEST_FILE);
+		map_free(entries, NULL);
+		return NULL;
+	}
+
+	FILE* file = fdopen(fd, "r");
+	char* line = NULL;
+	size_t alloc = 0;
+	ssize_t length;
+
+	while ((length = getline(&line, &alloc, file)) > 0) {
+		if (line[length - 1] == '\n') line[length - 1] = 0;
+
+		struct manifest_entry entry = { 0 };
+		int path = 0;
+
+		int fields = sscanf(
+			line, "%" SCNx64 " %zu %n", &entry.hash, &entry.size, &path
+		);
+		if (fields < 2 || path == 0 || !line[path]) continue;
+
+		struct manifest_entry* copy = malloc(sizeof(struct manifest_entry));
+		*copy = entry;
+		free(map_set(entries, line + path, copy));
+	}
+
+	free(line);
+	fclose(file);
+
+	return entries;
+}
+
+// hashes a file which is not in the last manifest, but was left as it was
+static bool hash_file(
+	int dir_fd,
+	const char* path,
+	struct manifest_entry* entry
+) {
+	int fd = openat(dir_fd, path, O_RDONLY);
+	if (fd == -1) return false;
+
+	char buf[8192];
+	ssize_t read_result;
+
+	entry->hash = hash_bytes(NULL, 0, 0);
+	entry->size = 0;
+
+	while ((read_result = read(fd, buf, sizeof(buf))) > 0) {
+		entry->hash = hash_bytes(buf, read_result, entry->hash);
+		entry->size += read_result;
+	}
+
+	close(fd);
+	return read_result == 0;
+}
+
+// deletes a file along with any compressed copies beside it, and then the
+// directories it leaves empty
+static int remove_output(int dir_fd, const char* path) {
+	if (unlinkat(dir_fd, path, 0) == -1 && errno != ENOENT) {
+		perrorf("failed to remove '%s'", path);
+		return 2;
+	}
+
+	const char* extensions[] = { ".gz", ".br" };
+	for (size_t i = 0; i < sizeof(extensions) / sizeof(extensions[0]); i++) {
+		char* compressed = asprintf("%s%s", path, extensions[i]);
+		unlinkat(dir_fd, compressed, 0);
+		free(compressed);
+	}
+
+	char* dir = astrndup(path, strlen(path));
+	for (char* slash; (slash = strrchr(dir, '/'));) {
+		*slash = 0;
+		if (unlinkat(dir_fd, dir, AT_REMOVEDIR) == -1) break;
+	}
+
+	free(dir);
+	return 0;
+}
+
+static void* collect_path(const char* path, void* entry, void* paths) {
+	if (entry) list_push(paths, (void*) path);
+	return NULL;
+}
+
+struct carry {
+	struct map* entries;
+	struct list* paths;
+};
+
+// with prune off, the files of the last run are current until written again
+static void* carry_entry(const char* path, void* entry, void* user) {
+	struct carry* carry = user;
+	if (map_get(carry->entries, path)) return NULL;
+
+	struct manifest_entry* copy = malloc(sizeof(struct manifest_entry));
+	*copy = *(struct manifest_entry*) entry;
+	copy->kept = true;
+
+	map_set(carry->entries, path, copy);
+	return NULL;
+}
+
+static void* collect_removed(const char* path, void* entry, void* user) {
+	struct carry* carry = user;
+	if (!map_get(carry->entries, path)) list_push(carry->paths, (void*) path);
+
+	return NULL;
+}
+
+static int compare_paths(const void* a, const void* b) {
+	return strcmp(*(const char**) a, *(const char**) b);
+}
+
+static int write_manifest(struct map* entries, struct list* paths, int dir_fd) {
+	char* data;
+	size_t length;
+	FILE* file = open_memstream(&data, &length);
+
+	LIST_ITER_T(paths, path, const char*) {
+		struct manifest_entry* entry = map_get(entries, path);
+		if (!entry) continue;
+
+		fprintf(file, "%016" PRIx64 " %zu %s\n", entry->hash, entry->size, path);
+	}
+
+	fclose(file);
+
+	// the manifest is replaced all at once, so a failed run leaves the last one
+	const char* temp = MANIFEST_FILE ".tmp";
+	int ret = write_at(dir_fd, temp, data, length);
+	free(data);
+
+	if (ret == 0 && renameat(dir_fd, temp, dir_fd, MANIFEST_FILE) == -1) {
+		perrorf("failed to write '%s'", MANIFEST_FILE);
+		ret = 2;
+	}
+
+	if (ret > 0) unlinkat(dir_fd, temp, 0);
+
+	return ret;
+}
+
+// prints the files added (A), changed (M) and removed (D) since the last
+// manifest, deletes the removed ones when pruning, and writes the new manifest;
+// the manifest is then cleared for the next run
+int manifest_finish(struct manifest* manifest, int dir_fd, bool prune) {
+	struct map* last = load_manifest(dir_fd);
+	if (last == NULL) return 2;
+
+	struct map* entries = manifest->entries;
+	struct carry carry = { entries, list_new() };
+	if (!prune) map_iter(last, carry_entry, &carry);
+
+	struct list* paths = list_new();
+	map_iter(entries, collect_path, paths);
+	list_sort(paths, compare_paths);
+
+	map_iter(last, collect_removed, &carry);
+	list_sort(carry.paths, compare_paths);
+
+	int ret = 0;
+
+	LIST_ITER_T(paths, path, const char*) {
+		struct manifest_entry* entry = map_get(entries, path);
+		struct manifest_entry* before = map_get(last, path);
+
+		if (entry->kept && before) {
+			entry->hash = before->hash;
+			entry->size = before->size;
+		} else if (entry->kept && !hash_file(dir_fd, path, entry)) {
+			free(map_set(entries, path, NULL));
+			continue;
+		}
+
+		if (!before) printf("A %s\n", path);
+		else if (entry->hash != before->hash || entry->size != before->size)
+			printf("M %s\n", path);
+	}
+
+	LIST_ITER_T(carry.paths, path, const char*) {
+		printf("D %s\n", path);
+
+		int remove_ret = remove_output(dir_fd, path);
+		if (remove_ret > ret) ret = remove_ret;
+	}
+
+	if (ret == 0) ret = write_manifest(entries, paths, dir_fd);
+
+	list_free(paths, NULL);
+	list_free(carry.paths, NULL);
+	map_free(last, free);
+
+	manifest_clear(manifest);
+
+	return ret;
+}
@@ -0,0 +1,23 @@
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define MANIFEST_FILE ".manifest"
+
+struct manifest;
+
+struct manifest* manifest_new();
+void manifest_free(struct manifest* manifest);
+void manifest_clear(struct manifest* manifest);
+void manifest_add(
+	struct manifest* manifest,
+	const char* path,
+	const char* data,
+	size_t length
+);
+void manifest_keep(struct manifest* manifest, const char* path);
+int manifest_finish(struct manifest* manifest, int dir_fd, bool prune);
+
+#endif // ifndef MANIFEST_H
@@ -160,6 +160,70 @@ void parse_marker(const char* line, int length, struct markers* markers) {
 #undef MARKER_MATCH
 }
 
+static bool check_type(const char* type, int length);
+
+// returns a description of what is wrong with the marker, or NULL if nothing is
+const char* check_marker(const char* line, int length, const char** code) {
+	size_t marker_length = strcspn(line + 1, "\t\r\n ");
+	const char* marker_end = line + 1 + marker_length;
+	const char* line_end = line + length;
+
+	if (marker_end > line_end) marker_end = line_end;
+
+	const char* args[3];
+	size_t arg_lengths[3];
+	int n_args = 0;
+
+	const char* arg = marker_end + strspn(marker_end, "\t\r\n ");
+	while (arg < line_end && n_args < 3) {
+		arg_lengths[n_args] = strcspn(arg, "\t\r\n ");
+		if (arg + arg_lengths[n_args] > line_end)
+			arg_lengths[n_args] = line_end - arg;
+
+		args[n_args++] = arg;
+
+		arg += arg_lengths[n_args - 1];
+		arg += strspn(arg, "\t\r\n ");
+	}
+
+#define MARKER_MATCH(s) \
+	(strlen(s) == marker_length && strncmp(line + 1, s, marker_length) == 0)
+
+	int type_arg = -1;
+
+	if (
+		MARKER_MATCH("const") || MARKER_MATCH("readonly") ||
+		MARKER_MATCH("var") || MARKER_MATCH("module") || MARKER_MATCH("class") ||
+		MARKER_MATCH("public") || MARKER_MATCH("private") ||
+		MARKER_MATCH("constructor") || MARKER_MATCH("static")
+	) {
+		return NULL;
+	} else if (MARKER_MATCH("type") || MARKER_MATCH("return")) {
+		type_arg = 0;
+	} else if (MARKER_MATCH("param") || MARKER_MATCH("prop")) {
+		type_arg = 1;
+	} else if (MARKER_MATCH("inherit")) {
+		type_arg = -1;
+	} else {
+		*code = "unknown-marker";
+		return "unknown marker";
+	}
+
+#undef MARKER_MATCH
+
+	if (n_args <= (type_arg > 0 ? type_arg : 0)) {
+		*code = "missing-argument";
+		return "marker is missing an argument";
+	}
+
+	if (type_arg >= 0 && !check_type(args[type_arg], arg_lengths[type_arg])) {
+		*code = "bad-type";
+		return "type does not follow the type grammar";
+	}
+
+	return NULL;
+}
+
 /*
 	grammar for type annotations:
 
@@ -234,7 +298,7 @@ static struct type_token* tokens_lex(char* atype) {
 			do {
 				i++;
 				length++;
-			} while (isalnum(atype[i]) || atype[i] == '_');
+			} while (isalnum(atype[i]) || atype[i] == '_' || atype[i] == '.');
 
 			ident = astrndup(atype + i - length, length);
 			i--;
@@ -472,3 +536,80 @@ static void parse_type(const char* type, int length, struct list** typeset) {
 	tokens_free(root);
 	free(atype);
 }
+
+struct type_cursor {
+	const char* at;
+	const char* end;
+};
+
+static bool check_type_union(struct type_cursor* cursor);
+
+static void skip_blank(struct type_cursor* cursor) {
+	while (cursor->at < cursor->end && isblank(*cursor->at)) cursor->at++;
+}
+
+static bool accept(struct type_cursor* cursor, char ch) {
+	skip_blank(cursor);
+
+	if (cursor->at < cursor->end && *cursor->at == ch) {
+		cursor->at++;
+		return true;
+	}
+
+	return false;
+}
+
+static bool check_type_item(struct type_cursor* cursor) {
+	skip_blank(cursor);
+	if (cursor->at >= cursor->end) return false;
+
+	char ch = *cursor->at;
+
+	if (accept(cursor, '[')) {
+		return check_type_union(cursor) && accept(cursor, ']');
+	} else if (accept(cursor, '{')) {
+		return check_type_union(cursor) && accept(cursor, '}');
+	} else if (ch == '<' || ch == '(') {
+		if (accept(cursor, '<'))
+			if (!check_type_union(cursor) || !accept(cursor, '>')) return false;
+
+		if (!accept(cursor, '(')) return false;
+		if (accept(cursor, ')')) return true;
+
+		do {
+			if (!check_type_union(cursor)) return false;
+		} while (accept(cursor, ','));
+
+		return accept(cursor, ')');
+	} else if (ch == '!' || ch == '*') {
+		cursor->at++;
+		return true;
+	} else if (isalpha(ch) || ch == '_') {
+		// class names may refer to other namespaces, so dots are allowed here
+		while (
+			cursor->at < cursor->end &&
+			(isalnum(*cursor->at) || *cursor->at == '_' || *cursor->at == '.')
+		) cursor->at++;
+
+		return cursor->at[-1] != '.';
+	}
+
+	return false;
+}
+
+static bool check_type_union(struct type_cursor* cursor) {
+	do {
+		if (!check_type_item(cursor)) return false;
+	} while (accept(cursor, '|'));
+
+	return true;
+}
+
+static bool check_type(const char* type, int length) {
+	struct type_cursor cursor = { type, type + length };
+
+	if (!check_type_union(&cursor)) return false;
+
+	skip_blank(&cursor);
+	return cursor.at == cursor.end;
+}
@@ -31,5 +31,6 @@ struct markers* markers_new();
 void markers_free(struct markers* markers);
 
 void parse_marker(const char* line, int length, struct markers* markers);
+const char* check_marker(const char* line, int length, const char** code);
 
 #endif // ifndef MARKER_H
@@ -0,0 +1,324 @@
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "object.h"
+#include "parse.h"
+#include "util.h"
+
+/*
+	a compiled object holds one parsed file, so that parsing can be done
+	separately from generation; integers are little-endian, and strings are a
+	32-bit length followed by the bytes, with NO_STRING for NULL
+
+	object:  "NDO" version, string source, string module (or NO_STRING), body
+	body:    string desc, u32 line, u32 count, count * (string name, body),
+	         u32 count, count * item
+	item:    string name, string desc, u32 line, u8 type, u32 count, then
+	         count * (string name, u8 flags) for a function, or count * item
+	         for a class
+*/
+
+#define MAGIC      "NDO"
+#define VERSION    1
+#define NO_STRING  UINT32_MAX
+#define PARAM_OPTIONAL 1
+#define PARAM_VARIABLE 2
+
+struct writer {
+	char* data;
+	size_t length, alloc;
+};
+
+static void put(struct writer* writer, const void* data, size_t length) {
+	if (writer->length + length > writer->alloc) {
+		while (writer->length + length > writer->alloc)
+			writer->alloc = writer->alloc ? writer->alloc * 2 : 4096;
+
+		writer->data = realloc(writer->data, writer->alloc);
+	}
+
+	memcpy(writer->data + writer->length, data, length);
+	writer->length += length;
+}
+
+static void put_u8(struct writer* writer, uint8_t value) {
+	put(writer, &value, 1);
+}
+
+static void put_u32(struct writer* writer, uint32_t value) {
+	uint8_t bytes[4] = { value, value >> 8, value >> 16, value >> 24 };
+	put(writer, bytes, 4);
+}
+
+static void put_string(struct writer* writer, const char* string) {
+	if (string == NULL) {
+		put_u32(writer, NO_STRING);
+	} else {
+		size_t length = strlen(string);
+
+		put_u32(writer, length);
+		put(writer, string, length);
+	}
+}
+
+static void put_item(struct writer* writer, struct item* item) {
+	put_string(writer, item->name);
+	put_string(writer, item->desc);
+	put_u32(writer, item->line);
+	put_u8(writer, item->type);
+
+	if (item->type == ITEM_FUNC) {
+		put_u32(writer, list_length(item->items));
+
+		LIST_ITER_T(item->items, param, struct param*) {
+			put_string(writer, param->name);
+			put_u8(
+				writer,
+				(param->optional ? PARAM_OPTIONAL : 0) |
+				(param->variable ? PARAM_VARIABLE : 0)
+			);
+		}
+	} else if (item->type == ITEM_CLASS) {
+		put_u32(writer, list_length(item->items));
+
+		LIST_ITER_T(item->items, child, struct item*)
+			put_item(writer, child);
+	} else {
+		put_u32(writer, 0);
+	}
+}
+
+static void put_body(struct writer* writer, struct module* module) {
+	put_string(writer, module->desc);
+	put_u32(writer, module->line);
+
+	put_u32(writer, list_length(module->children));
+	LIST_ITER_T(module->children, child, struct module*) {
+		put_string(writer, child->name);
+		put_body(writer, child);
+	}
+
+	put_u32(writer, list_length(module->items));
+	LIST_ITER_T(module->items, item, struct item*)
+		put_item(writer, item);
+}
+
+int write_object(
+	const char* path,
+	const char* source,
+	const char* module,
+	struct module* fragment
+) {
+	struct writer writer = { 0 };
+
+	put(&writer, MAGIC, 3);
+	put_u8(&writer, VERSION);
+	put_string(&writer, source);
+	put_string(&writer, module);
+	put_body(&writer, fragment);
+
+	int ret = write_at(AT_FDCWD, path, writer.data, writer.length);
+	free(writer.data);
+
+	return ret;
+}
+
+struct reader {
+	const char* path;
+	const char* fr;
+	unsigned char* data;
+	size_t length, offset;
+	bool failed;
+};
+
+static bool take(struct reader* reader, size_t length) {
+	if (reader->failed || reader->length - reader->offset < length) {
+		reader->failed = true;
+		return false;
+	}
+
+	reader->offset += length;
+	return true;
+}
+
+static uint8_t get_u8(struct reader* reader) {
+	if (!take(reader, 1)) return 0;
+
+	return reader->data[reader->offset - 1];
+}
+
+static uint32_t get_u32(struct reader* reader) {
+	if (!take(reader, 4)) return 0;
+
+	unsigned char* bytes = reader->data + reader->offset - 4;
+	return
+		(uint32_t) bytes[0] | (uint32_t) bytes[1] << 8 |
+		(uint32_t) bytes[2] << 16 | (uint32_t) bytes[3] << 24;
+}
+
+static char* get_string(struct reader* reader) {
+	uint32_t length = get_u32(reader);
+	if (length == NO_STRING || !take(reader, length)) return NULL;
+
+	return astrndup(
+		(char*) reader->data + reader->offset - length, length
+	);
+}
+
+static struct item* get_item(struct reader* reader) {
+	struct item* item = calloc(1, sizeof(struct item));
+	item->filename = reader->fr;
+	item->name = get_string(reader);
+	item->desc = get_string(reader);
+	item->line = get_u32(reader);
+	item->type = get_u8(reader);
+
+	uint32_t count = get_u32(reader);
+
+	if (item->type == ITEM_CLASS || item->type == ITEM_FUNC)
+		item->items = list_new();
+	else if (item->type != ITEM_VAR || count > 0)
+		reader->failed = true;
+
+	for (uint32_t i = 0; i < count && !reader->failed; i++) {
+		if (item->type == ITEM_FUNC) {
+			struct param* param = malloc(sizeof(struct param));
+			param->name = get_string(reader);
+
+			uint8_t flags = get_u8(reader);
+			param->optional = flags & PARAM_OPTIONAL;
+			param->variable = flags & PARAM_VARIABLE;
+
+			list_push(item->items, param);
+		} else {
+			list_push(item->items, get_item(reader));
+		}
+	}
+
+	// a valid object never has a NULL name, so one here is a sign of truncation
+	if (item->name == NULL) reader->failed = true;
+
+	return item;
+}
+
+static void get_body(struct reader* reader, struct module* module) {
+	module->filename = reader->fr;
+	module->desc = get_string(reader);
+	module->line = get_u32(reader);
+
+	uint32_t count = get_u32(reader);
+	for (uint32_t i = 0; i < count && !reader->failed; i++) {
+		struct module* child = calloc(1, sizeof(struct module));
+		child->children = list_new();
+		child->items = list_new();
+		child->name = get_string(reader);
+
+		list_push(module->children, child);
+		get_body(reader, child);
+	}
+
+	count = get_u32(reader);
+	for (uint32_t i = 0; i < count && !reader->failed; i++)
+		list_push(module->items, get_item(reader));
+}
+
+static int open_reader(struct reader* reader, const char* path) {
+	*reader = (struct reader) { .path = path };
+
+	int fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		perrorf("failed to open '%s'", path);
+		return 2;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) == -1) {
+		perrorf("failed to read '%s'", path);
+		close(fd);
+		return 2;
+	}
+
+	reader->length = st.st_size;
+	reader->data = malloc(reader->length + 1);
+
+	ssize_t read_result;
+	for (size_t i = 0; i < reader->length; i += read_result) {
+		read_result = read(fd, reader->data + i, reader->length - i);
+
+		if (read_result <= 0) {
+			perrorf("failed to read '%s'", path);
+			close(fd);
+			free(reader->data);
+			return 2;
+		}
+	}
+
+	close(fd);
+
+	if (
+		reader->length < 4 ||
+		memcmp(reader->data, MAGIC, 3) != 0 ||
+		reader->data[3] != VERSION
+	) {
+		errorf("'%s' is not a compiled object of this version\n", path);
+		free(reader->data);
+		return 3;
+	}
+
+	reader->offset = 4;
+
+	return 0;
+}
+
+int read_object_header(const char* path, char** source, char** module) {
+	struct reader reader;
+	int ret = open_reader(&reader, path);
+	if (ret > 0) return ret;
+
+	*source = get_string(&reader);
+	*module = get_string(&reader);
+	free(reader.data);
+
+	if (reader.failed || *source == NULL) {
+		errorf("'%s' is truncated\n", path);
+		free(*source);
+		free(*module);
+		return 3;
+	}
+
+	return 0;
+}
+
+// loads the fragment of a compiled object, attributing everything to fr
+int read_object(const char* path, const char* fr, struct module** fragment) {
+	struct reader reader;
+	int ret = open_reader(&reader, path);
+	if (ret > 0) return ret;
+
+	reader.fr = fr;
+
+	free(get_string(&reader));
+	free(get_string(&reader));
+
+	struct module* module = calloc(1, sizeof(struct module));
+	module->children = list_new();
+	module->items = list_new();
+
+	get_body(&reader, module);
+	free(reader.data);
+
+	if (reader.failed) {
+		errorf("'%s' is truncated\n", path);
+		module_free(module);
+		return 3;
+	}
+
+	*fragment = module;
+	return 0;
+}
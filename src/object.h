@@ -0,0 +1,15 @@
+#ifndef OBJECT_H
+#define OBJECT_H
+
+#include "parse.h"
+
+int write_object(
+	const char* path,
+	const char* source,
+	const char* module,
+	struct module* fragment
+);
+int read_object_header(const char* path, char** source, char** module);
+int read_object(const char* path, const char* fr, struct module** fragment);
+
+#endif // ifndef OBJECT_H
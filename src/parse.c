@@ -1,6 +1,7 @@
 #include <ctype.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -16,8 +17,11 @@
 #include "parse.h"
 #include "util.h"
 
-extern char* const* argv;
-const char* current_file;
+// per thread, so that files can be checked in parallel
+static _Thread_local const char* current_file;
+static _Thread_local struct list* diagnostics; /* diagnostic, when checking */
+static _Thread_local struct list* loads; /* load, when following loads */
+static _Thread_local struct list* references; /* reference, when checking */
 
 struct line {
 	const char* start;
@@ -29,6 +33,7 @@ struct line {
 static void parse_toplevel(struct Token*, struct line*, struct module*);
 static void parse_object(struct Token*, struct line*, struct list*, struct list*);
 static void parse_function(struct Token*, struct list*);
+static void find_loads(struct Token*);
 
 static struct Token* clone_token(struct Token* tok, struct Token* parent) {
 	struct Token* clone = malloc(sizeof(struct Token));
@@ -59,6 +64,90 @@ static void free_token(struct Token* tok) {
 	free(tok);
 }
 
+static void report(int line, bool error, const char* code, char* message) {
+	struct diagnostic* diagnostic = malloc(sizeof(struct diagnostic));
+	*diagnostic = (struct diagnostic) {
+		current_file, line, error, code, message
+	};
+
+	list_push(diagnostics, diagnostic);
+}
+
+void diagnostic_free(struct diagnostic* diagnostic) {
+	free(diagnostic->message);
+	free(diagnostic);
+}
+
+void reference_free(struct reference* reference) {
+	free(reference->name);
+	free(reference);
+}
+
+// references to classes in markers are collected if references is not NULL, and
+// the parsed module is kept if fragment is not NULL
+int check_file(
+	const char* filename,
+	const char* fr,
+	struct list* problems,
+	struct list* found,
+	struct module** fragment
+) {
+	struct module* module = calloc(1, sizeof(struct module));
+	module->children = list_new();
+	module->items = list_new();
+
+	diagnostics = problems;
+	references = found;
+	int ret = parse_file(filename, fr, module);
+	diagnostics = NULL;
+	references = NULL;
+
+	if (ret == 2) {
+		struct diagnostic* diagnostic = malloc(sizeof(struct diagnostic));
+		*diagnostic = (struct diagnostic) {
+			fr, 0, true, "io-error", asprintf("failed to read file")
+		};
+
+		list_push(problems, diagnostic);
+	}
+
+	if (ret == 0 && fragment) *fragment = module;
+	else module_free(module);
+
+	return ret;
+}
+
+static pthread_once_t nasal_once = PTHREAD_ONCE_INIT;
+
+static void nasal_init() {
+	naFreeContext(naNewContext());
+}
+
+// nasal sets up its globals when the first context is created, which must not
+// race between threads, so this must be called before parsing on several
+void parse_init() {
+	pthread_once(&nasal_once, nasal_init);
+}
+
+int parse_file_loads(
+	const char* filename,
+	const char* fr,
+	struct module* module,
+	struct list* found
+) {
+	loads = found;
+	int ret = parse_file(filename, fr, module);
+	loads = NULL;
+
+	return ret;
+}
+
+void load_free(struct load* load) {
+	free(load->path);
+	free(load->module);
+	free(load);
+}
+
 int parse_file(const char* rawfilename, const char* fr, struct module* module) {
 	current_file = fr;
 
@@ -76,7 +165,12 @@ int parse_file(const char* rawfilename, const char* fr, struct module* module) {
 
 	if (naIsNil(codeRef)) {
 		char* err = naGetError(ctx);
-		fprintf(stderr, "%s: %s:%d: %s\n", argv[0], rawfilename, errLine, err);
+
+		if (diagnostics)
+			report(errLine, true, "parse-error", asprintf("%s", err));
+		else
+			errorf("%s:%d: %s\n", rawfilename, errLine, err);
+
 		return 3;
 	}
 
@@ -128,6 +222,7 @@ int parse_file(const char* rawfilename, const char* fr, struct module* module) {
 	module->desc = desc;
 
 	parse_toplevel(root, lines, module);
+	if (loads) find_loads(root);
 
 	free_token(root);
 	free(file);
@@ -136,6 +231,31 @@ int parse_file(const char* rawfilename, const char* fr, struct module* module) {
 	return 0;
 }
 
+static void param_free(struct param* param) {
+	free(param->name);
+	free(param);
+}
+
+void item_free(struct item* item) {
+	if (item->type == ITEM_FUNC)
+		list_free(item->items, (void (*)(void*)) param_free);
+	else if (item->type == ITEM_CLASS)
+		list_free(item->items, (void (*)(void*)) item_free);
+
+	free(item->name);
+	free(item->desc);
+	free(item);
+}
+
+void module_free(struct module* module) {
+	list_free(module->children, (void (*)(void*)) module_free);
+	list_free(module->items, (void (*)(void*)) item_free);
+
+	free(module->name);
+	free(module->desc);
+	free(module);
+}
+
 // ugly hack: overrides the call to naCodeGen at the end of naParse code
 // instead of doing code generation, we'll clone and return the token tree
 naRef naCodeGen(struct Parser* _p, struct Token* block, struct Token* _null) {
@@ -145,6 +265,102 @@ naRef naCodeGen(struct Parser* _p, struct Token* block, struct Token* _null) {
 	return ret;
 }
 
+static void* filter_param(void* param, void* name) {
+	struct param* test = param;
+
+	if (strcmp(name, "...") == 0) return test->variable ? param : NULL;
+	return strcmp(test->name, name) == 0 ? param : NULL;
+}
+
+static void check_params(struct item* item, struct list* params) {
+	if (item->type != ITEM_FUNC) {
+		report(
+			item->line, false, "param-on-non-function",
+			asprintf("'%s' has @param markers but is not a function", item->name)
+		);
+
+		return;
+	}
+
+	LIST_ITER_T(params, param, struct marker_pair_named*) {
+		if (list_iter(item->items, filter_param, param->name)) continue;
+
+		report(
+			item->line, true, "unknown-param",
+			asprintf(
+				"@param '%s' does not match any parameter of '%s'",
+				param->name, item->name
+			)
+		);
+	}
+}
+
+static void reference_typeset(int line, struct list* typeset);
+
+static void reference_type(int line, struct type* type) {
+	switch (type->type) {
+		case TYPE_OBJ: {}
+			struct reference* reference = malloc(sizeof(struct reference));
+			*reference = (struct reference) {
+				current_file, line,
+				astrndup(type->data.class, strlen(type->data.class))
+			};
+
+			list_push(references, reference);
+			break;
+
+		case TYPE_LIST:
+		case TYPE_HASH:
+			reference_typeset(line, type->data.typeset);
+			break;
+
+		case TYPE_FUNC:
+			LIST_ITER_T(type->data.func.param_typesets, typeset, struct list*)
+				reference_typeset(line, typeset);
+			reference_typeset(line, type->data.func.return_typeset);
+			break;
+
+		default:
+			break;
+	}
+}
+
+static void reference_typeset(int line, struct list* typeset) {
+	if (typeset == NULL) return;
+
+	LIST_ITER_T(typeset, type, struct type*)
+		reference_type(line, type);
+}
+
+// collects the classes named by the markers of an item, to be resolved once
+// everything has been parsed
+static void reference_markers(int line, struct markers* markers) {
+	reference_typeset(line, markers->type);
+
+	if (markers->returns)
+		LIST_ITER_T(markers->returns, pair, struct marker_pair*)
+			reference_typeset(line, pair->typeset);
+
+	struct list* named[] = { markers->params, markers->props };
+	for (int i = 0; i < 2; i++) {
+		if (named[i] == NULL) continue;
+
+		LIST_ITER_T(named[i], pair, struct marker_pair_named*)
+			reference_typeset(line, pair->typeset);
+	}
+
+	if (markers->inheritance) {
+		LIST_ITER_T(markers->inheritance, name, char*) {
+			struct reference* reference = malloc(sizeof(struct reference));
+			*reference = (struct reference) {
+				current_file, line, astrndup(name, strlen(name))
+			};
+
+			list_push(references, reference);
+		}
+	}
+}
+
 static void process_item(
 	int line,
 	char* name,
@@ -156,6 +372,7 @@ static void process_item(
 	char* desc = malloc(1);
 	int length = 0;
 	struct markers* markers = markers_new();
+	struct markers* checked = diagnostics ? markers_new() : NULL;
 
 	for (int i = line - 2; i >= 0; i--) {
 		if (lines[i].start_nows[0] != '#') break;
@@ -166,6 +383,15 @@ static void process_item(
 		const char* line_end = lines[i].start + lines[i].length;
 		size_t line_length = line_end - lines[i].start_nows - hashes - spaces;
 
+		if (checked && *(line_end - line_length) == '@') {
+			const char* code;
+			const char* problem =
+				check_marker(line_end - line_length, line_length, &code);
+
+			if (problem) report(i + 1, true, code, asprintf("%s", problem));
+			else parse_marker(line_end - line_length, line_length, checked);
+		}
+
 		if (0 && *(line_end - line_length) == '@') { // TEMPORARY - FIXME!
 			parse_marker(line_end - line_length, line_length, markers);
 		} else {
@@ -229,9 +455,14 @@ static void process_item(
 			item->type = ITEM_VAR;
 			item->items = NULL;
 		}
+
+		if (checked && checked->params) check_params(item, checked->params);
 	}
 
+	if (checked && references) reference_markers(line, checked);
+
 	markers_free(markers);
+	if (checked) markers_free(checked);
 }
 
 static void parse_toplevel(
@@ -410,3 +641,50 @@ static void parse_function(struct Token* tok, struct list* params) {
 
 	parse_param(item, params);
 }
+
+static bool is_symbol(struct Token* tok, const char* name) {
+	return
+		tok != NULL && tok->type == TOK_SYMBOL &&
+		tok->strlen == strlen(name) && strncmp(tok->str, name, tok->strlen) == 0;
+}
+
+static bool is_string(struct Token* tok) {
+	return tok != NULL && tok->type == TOK_LITERAL && tok->str != NULL;
+}
+
+// collects calls to io.load_nasal and io.include whose paths are literals, from
+// anywhere in the file
+static void find_loads(struct Token* tok) {
+	for (; tok != NULL; tok = tok->next) {
+		struct Token* func = tok->children;
+		struct Token* args = tok->lastChild;
+
+		if (
+			tok->type == TOK_LPAR && func != NULL && args != func &&
+			func->type == TOK_DOT && is_symbol(func->children, "io") && (
+				is_symbol(func->lastChild, "load_nasal") ||
+				is_symbol(func->lastChild, "include")
+			)
+		) {
+			struct Token* path = args->type == TOK_COMMA ? args->children : args;
+			struct Token* module = args->type == TOK_COMMA ? args->lastChild : NULL;
+			if (module && module->type == TOK_COMMA) module = module->children;
+
+			if (is_string(path)) {
+				struct load* load = malloc(sizeof(struct load));
+				*load = (struct load) {
+					.path = astrndup(path->str, path->strlen),
+					.module = is_string(module)
+						? astrndup(module->str, module->strlen)
+						: NULL,
+					.include = is_symbol(func->lastChild, "include"),
+					.line = tok->line,
+				};
+
+				list_push(loads, load);
+			}
+		}
+
+		find_loads(tok->children);
+	}
+}
@@ -61,6 +61,47 @@ struct module {
 	struct list* items;    /* item */
 };
 
+struct diagnostic {
+	const char* file;
+	int line;
+	bool error;
+	const char* code;
+	char* message;
+};
+
+struct reference {
+	const char* file;
+	int line;
+	char* name; /* class name, as written in a marker */
+};
+
+struct load {
+	char* path;
+	char* module; /* NULL unless given */
+	bool include;
+	int line;
+};
+
+void parse_init();
 int parse_file(const char* filename, const char* fr, struct module* module);
+int parse_file_loads(
+	const char* filename,
+	const char* fr,
+	struct module* module,
+	struct list* loads
+);
+void load_free(struct load* load);
+int check_file(
+	const char* filename,
+	const char* fr,
+	struct list* problems,
+	struct list* references,
+	struct module** fragment
+);
+void diagnostic_free(struct diagnostic* diagnostic);
+void reference_free(struct reference* reference);
+
+void module_free(struct module* module);
+void item_free(struct item* item);
 
 #endif // ifndef PARSE_H
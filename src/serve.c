@@ -0,0 +1,244 @@
+#include <errno.h>
+#include <netdb.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "generate.h"
+#include "parse.h"
+#include "serve.h"
+#include "util.h"
+
+#define DEFAULT_HOST "127.0.0.1"
+#define REQUEST_MAX  8192
+
+static const struct {
+	const char* extension;
+	const char* type;
+} content_types[] = {
+	{ ".html", "text/html; charset=utf-8" },
+	{ ".css", "text/css; charset=utf-8" },
+	{ ".js", "text/javascript; charset=utf-8" },
+	{ ".json", "application/json" },
+	{ ".png", "image/png" },
+	{ ".svg", "image/svg+xml" },
+	{ ".woff2", "font/woff2" },
+};
+
+static const char* content_type(const char* path) {
+	const char* extension = strrchr(path, '.');
+
+	if (extension) {
+		for (size_t i = 0; i < sizeof(content_types) / sizeof(*content_types); i++)
+			if (strcmp(extension, content_types[i].extension) == 0)
+				return content_types[i].type;
+	}
+
+	return "application/octet-stream";
+}
+
+static int listen_on(const char* address) {
+	// accepts PORT, HOST:PORT or :PORT, where the host defaults to loopback
+	const char* colon = strrchr(address, ':');
+	char* host = colon
+		? astrndup(address, colon - address)
+		: astrndup(DEFAULT_HOST, strlen(DEFAULT_HOST));
+	const char* port = colon ? colon + 1 : address;
+
+	if (host[0] == 0) {
+		free(host);
+		host = astrndup(DEFAULT_HOST, strlen(DEFAULT_HOST));
+	}
+
+	struct addrinfo hints = {
+		.ai_family = AF_UNSPEC,
+		.ai_socktype = SOCK_STREAM,
+		.ai_flags = AI_PASSIVE,
+	}, *result;
+
+	int ret = getaddrinfo(host, port, &hints, &result);
+	free(host);
+
+	if (ret != 0) {
+		errorf("failed to resolve '%s' (%s)\n", address, gai_strerror(ret));
+		return -1;
+	}
+
+	int fd = -1;
+	for (struct addrinfo* ai = result; ai; ai = ai->ai_next) {
+		fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if (fd == -1) continue;
+
+		int yes = 1;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+		if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, 16) == 0)
+			break;
+
+		close(fd);
+		fd = -1;
+	}
+
+	freeaddrinfo(result);
+
+	if (fd == -1) perrorf("failed to listen on '%s'", address);
+
+	return fd;
+}
+
+static int hex_value(char ch) {
+	if (ch >= '0' && ch <= '9') return ch - '0';
+	if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+	if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+	return -1;
+}
+
+// decodes the request target in place into a path relative to the output, or
+// returns false if it is malformed or tries to escape the output
+static bool decode_path(char* target) {
+	if (target[0] != '/') return false;
+
+	size_t j = 0;
+	for (size_t i = 1; target[i] && target[i] != '?' && target[i] != '#'; i++) {
+		if (target[i] == '%') {
+			int high = hex_value(target[i + 1]);
+			int low = high == -1 ? -1 : hex_value(target[i + 2]);
+			if (low == -1) return false;
+
+			target[j++] = high * 16 + low;
+			i += 2;
+		} else {
+			target[j++] = target[i];
+		}
+	}
+
+	target[j] = 0;
+
+	for (char* segment = target; segment; segment = strchr(segment, '/')) {
+		if (segment[0] == '/') segment++;
+		if (strncmp(segment, "..", 2) == 0 && (!segment[2] || segment[2] == '/'))
+			return false;
+	}
+
+	return strlen(target) == j;
+}
+
+static void respond(
+	int fd,
+	const char* status,
+	const char* type,
+	const char* data,
+	size_t length,
+	bool head
+) {
+	char* header = asprintf(
+		"HTTP/1.1 %s\r\n"
+		"Content-Type: %s\r\n"
+		"Content-Length: %zu\r\n"
+		"Cache-Control: no-cache\r\n"
+		"Connection: close\r\n"
+		"\r\n",
+		status, type, length
+	);
+
+	ssize_t written = write(fd, header, strlen(header));
+	free(header);
+
+	for (size_t sent = 0; !head && written >= 0 && sent < length; sent += written)
+		written = write(fd, data + sent, length - sent);
+}
+
+static void handle(
+	int fd,
+	struct generator* gen,
+	struct module* root,
+	struct source sources[]
+) {
+	char request[REQUEST_MAX + 1];
+	size_t length = 0;
+
+	// only the request line is needed, so stop reading once it is complete
+	while (length < REQUEST_MAX && !memchr(request, '\n', length)) {
+		ssize_t read_result = read(fd, request + length, REQUEST_MAX - length);
+		if (read_result <= 0) return;
+
+		length += read_result;
+	}
+
+	request[length] = 0;
+	request[strcspn(request, "\r\n")] = 0;
+
+	char* method = request;
+	char* target = strchr(method, ' ');
+	if (target == NULL) {
+		respond(fd, "400 Bad Request", "text/plain", "bad request\n", 12, false);
+		return;
+	}
+
+	*target++ = 0;
+	target[strcspn(target, " ")] = 0;
+
+	bool head = strcmp(method, "HEAD") == 0;
+	if (!head && strcmp(method, "GET") != 0) {
+		respond(
+			fd, "405 Method Not Allowed", "text/plain", "not allowed\n", 12, false
+		);
+		return;
+	}
+
+	if (!decode_path(target)) {
+		respond(fd, "400 Bad Request", "text/plain", "bad request\n", 12, false);
+		return;
+	}
+
+	const char* data;
+	size_t data_length;
+
+	if (generator_render(gen, root, sources, target, &data, &data_length) != 0) {
+		respond(fd, "404 Not Found", "text/plain", "not found\n", 10, head);
+		return;
+	}
+
+	// a dir is served as its index.html, which its type is taken from
+	size_t target_length = strlen(target);
+	bool dir = target_length == 0 || target[target_length - 1] == '/';
+
+	const char* type = content_type(dir ? "index.html" : target);
+	respond(fd, "200 OK", type, data, data_length, head);
+}
+
+int serve(
+	const char* address,
+	struct generator* gen,
+	struct module* root,
+	struct source sources[]
+) {
+	int listen_fd = listen_on(address);
+	if (listen_fd == -1) return 2;
+
+	signal(SIGPIPE, SIG_IGN);
+
+	errorf("serving documentation on %s\n", address);
+
+	while (true) {
+		int fd = accept(listen_fd, NULL, NULL);
+		if (fd == -1) {
+			if (errno == EINTR || errno == ECONNABORTED) continue;
+
+			perrorf("failed to accept connection");
+			break;
+		}
+
+		handle(fd, gen, root, sources);
+		close(fd);
+	}
+
+	close(listen_fd);
+
+	return 2;
+}
@@ -0,0 +1,14 @@
+#ifndef SERVE_H
+#define SERVE_H
+
+#include "generate.h"
+#include "parse.h"
+
+int serve(
+	const char* address,
+	struct generator* gen,
+	struct module* root,
+	struct source sources[]
+);
+
+#endif // ifndef SERVE_H
@@ -0,0 +1,271 @@
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "parse.h"
+#include "symbols.h"
+#include "util.h"
+
+/*
+	a symbol table lists every module and item of a library by its dotted path,
+	with the url of its page relative to the root of the library's output; it is
+	read with mmap, and looked up with a binary search over the sorted offsets
+
+	table:   "NDS" version, u32 count, u32 library, count * u32 entry, strings
+	entry:   path '\0' url '\0'
+
+	integers are little-endian offsets from the start of the table
+*/
+
+#define MAGIC   "NDS"
+#define VERSION 1
+#define HEADER  12
+
+struct symbol {
+	char* path;
+	char* url;
+};
+
+struct symbols {
+	const unsigned char* data;
+	size_t length;
+	uint32_t count;
+};
+
+static void add_symbol(struct list* symbols, char* path, char* url) {
+	struct symbol* symbol = malloc(sizeof(struct symbol));
+	*symbol = (struct symbol) { path, url };
+
+	list_push(symbols, symbol);
+}
+
+static char* join(const char* path, const char* name) {
+	return path[0] ? asprintf("%s.%s", path, name) : asprintf("%s", name);
+}
+
+// the url of the page of a module or class, whose own dir is dir
+static char* container_url(
+	enum symbols_layout layout,
+	const char* path,
+	const char* dir
+) {
+	if (layout == LAYOUT_SPA) return asprintf("index.html#%s", path);
+	return asprintf("%sindex.html", dir);
+}
+
+// the url of a var or func, in the module or class at path and dir
+static char* member_url(
+	enum symbols_layout layout,
+	const char* path,
+	const char* dir,
+	struct item* item
+) {
+	const char* prefix = item->type == ITEM_VAR ? "var" : "func";
+
+	switch (layout) {
+		case LAYOUT_SPA:
+			return asprintf("index.html#%s/%s.%s", path, prefix, item->name);
+		case LAYOUT_AGGREGATE:
+			return asprintf("%sindex.html#%s.%s", dir, prefix, item->name);
+		default:
+			return asprintf("%s%s.%s.html", dir, prefix, item->name);
+	}
+}
+
+static void collect_items(
+	struct list* symbols,
+	struct list* items,
+	const char* path,
+	const char* dir,
+	enum symbols_layout layout
+) {
+	LIST_ITER_T(items, item, struct item*) {
+		char* item_path = join(path, item->name);
+
+		if (item->type == ITEM_CLASS) {
+			char* item_dir = asprintf("%s%s/", dir, item->name);
+
+			add_symbol(
+				symbols, item_path, container_url(layout, item_path, item_dir)
+			);
+			collect_items(symbols, item->items, item_path, item_dir, layout);
+
+			free(item_dir);
+		} else {
+			add_symbol(symbols, item_path, member_url(layout, path, dir, item));
+		}
+	}
+}
+
+static void collect_module(
+	struct list* symbols,
+	struct module* module,
+	const char* path,
+	const char* dir,
+	enum symbols_layout layout
+) {
+	collect_items(symbols, module->items, path, dir, layout);
+
+	LIST_ITER_T(module->children, child, struct module*) {
+		char* child_path = join(path, child->name);
+		char* child_dir = asprintf("%s%s/", dir, child->name);
+
+		add_symbol(
+			symbols, child_path, container_url(layout, child_path, child_dir)
+		);
+		collect_module(symbols, child, child_path, child_dir, layout);
+
+		free(child_dir);
+	}
+}
+
+static int comp_symbol(const struct symbol** a, const struct symbol** b) {
+	return strcmp((*a)->path, (*b)->path);
+}
+
+static void put_u32(unsigned char* at, uint32_t value) {
+	at[0] = value;
+	at[1] = value >> 8;
+	at[2] = value >> 16;
+	at[3] = value >> 24;
+}
+
+static uint32_t get_u32(const unsigned char* at) {
+	return
+		(uint32_t) at[0] | (uint32_t) at[1] << 8 |
+		(uint32_t) at[2] << 16 | (uint32_t) at[3] << 24;
+}
+
+static void symbol_free(struct symbol* symbol) {
+	free(symbol->path);
+	free(symbol->url);
+	free(symbol);
+}
+
+int write_symbols(
+	const char* path,
+	const char* library,
+	struct module* root,
+	enum symbols_layout layout
+) {
+	struct list* symbols = list_new();
+	collect_module(symbols, root, "", "", layout);
+	list_sort(symbols, (int (*)(const void*, const void*)) comp_symbol);
+
+	uint32_t count = list_length(symbols);
+	size_t length = HEADER + 4 * count + strlen(library) + 1;
+	LIST_ITER_T(symbols, symbol, struct symbol*)
+		length += strlen(symbol->path) + strlen(symbol->url) + 2;
+
+	unsigned char* data = malloc(length);
+	memcpy(data, MAGIC, 3);
+	data[3] = VERSION;
+	put_u32(data + 4, count);
+
+	size_t offset = HEADER + 4 * count;
+	put_u32(data + 8, offset);
+	strcpy((char*) data + offset, library);
+	offset += strlen(library) + 1;
+
+	for (uint32_t i = 0; i < count; i++) {
+		struct symbol* symbol = list_get(symbols, i);
+		put_u32(data + HEADER + 4 * i, offset);
+
+		strcpy((char*) data + offset, symbol->path);
+		offset += strlen(symbol->path) + 1;
+		strcpy((char*) data + offset, symbol->url);
+		offset += strlen(symbol->url) + 1;
+	}
+
+	list_free(symbols, (void (*)(void*)) symbol_free);
+
+	int ret = write_at(AT_FDCWD, path, data, length);
+	free(data);
+
+	return ret;
+}
+
+struct symbols* symbols_open(const char* path) {
+	int fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		perrorf("failed to open '%s'", path);
+		return NULL;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) == -1) {
+		perrorf("failed to read '%s'", path);
+		close(fd);
+		return NULL;
+	}
+
+	const unsigned char* data = NULL;
+	if (st.st_size > 0) {
+		data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED) data = NULL;
+	}
+
+	close(fd);
+
+	// the strings are only ever compared, and the last one is terminated, so
+	// checking the offsets as they are used is enough to stay in bounds
+	if (
+		data == NULL || st.st_size < HEADER ||
+		memcmp(data, MAGIC, 3) != 0 || data[3] != VERSION ||
+		data[st.st_size - 1] != 0 ||
+		(st.st_size - HEADER) / 4 < get_u32(data + 4) ||
+		get_u32(data + 8) >= st.st_size
+	) {
+		errorf("'%s' is not a symbol table of this version\n", path);
+		if (data) munmap((void*) data, st.st_size);
+		return NULL;
+	}
+
+	struct symbols* table = malloc(sizeof(struct symbols));
+	table->data = data;
+	table->length = st.st_size;
+	table->count = get_u32(data + 4);
+
+	return table;
+}
+
+const char* symbols_library(struct symbols* table) {
+	return (const char*) table->data + get_u32(table->data + 8);
+}
+
+// returns the url of the page for name, or NULL if it is not in the table
+const char* symbols_lookup(struct symbols* table, const char* name) {
+	uint32_t low = 0, high = table->count;
+
+	while (low < high) {
+		uint32_t mid = low + (high - low) / 2;
+		uint32_t offset = get_u32(table->data + HEADER + 4 * mid);
+		if (offset >= table->length) return NULL;
+
+		const char* path = (const char*) table->data + offset;
+		int comp = strcmp(name, path);
+
+		if (comp == 0) {
+			size_t url = offset + strlen(path) + 1;
+			return url < table->length ? (const char*) table->data + url : NULL;
+		}
+
+		if (comp < 0) high = mid;
+		else low = mid + 1;
+	}
+
+	return NULL;
+}
+
+void symbols_close(struct symbols* table) {
+	if (table == NULL) return;
+
+	munmap((void*) table->data, table->length);
+	free(table);
+}
@@ -0,0 +1,29 @@
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+#include <stdbool.h>
+
+#include "parse.h"
+
+struct symbols;
+
+// where the pages of a library are, which the urls in its table follow
+enum symbols_layout {
+	LAYOUT_PAGES,     /* a page for every module and item */
+	LAYOUT_AGGREGATE, /* vars and funcs are sections of their parent's page */
+	LAYOUT_SPA,       /* one page, routed by the location hash */
+};
+
+int write_symbols(
+	const char* path,
+	const char* library,
+	struct module* root,
+	enum symbols_layout layout
+);
+
+struct symbols* symbols_open(const char* path);
+const char* symbols_library(struct symbols* table);
+const char* symbols_lookup(struct symbols* table, const char* name);
+void symbols_close(struct symbols* table);
+
+#endif // ifndef SYMBOLS_H
@@ -1,3 +1,4 @@
+#include <errno.h>
 #include <fcntl.h>
 #include <stdarg.h>
 #include <stdbool.h>
@@ -139,7 +140,139 @@ bool list_iter_continue(struct list* this) {
 	return this->iter < this->length;
 }
 
-extern char* const* argv;
+#define MAP_INITIAL 16
+
+struct map_entry {
+	char* key;
+	uint64_t hash;
+	void* value;
+};
+
+struct map {
+	int length, alloc;
+	struct map_entry* entries;
+};
+
+struct map* map_new() {
+	struct map* this = malloc(sizeof(struct map));
+	this->length = 0;
+	this->alloc = MAP_INITIAL;
+	this->entries = calloc(MAP_INITIAL, sizeof(struct map_entry));
+
+	return this;
+}
+
+void map_free(struct map* this, void (* each)(void*)) {
+	if (this == NULL) return;
+	if (each == NULL) each = drop;
+
+	for (int i = 0; i < this->alloc; i++) {
+		if (this->entries[i].key == NULL) continue;
+
+		free(this->entries[i].key);
+		each(this->entries[i].value);
+	}
+
+	free(this->entries);
+	free(this);
+}
+
+int map_length(struct map* this) {
+	return this->length;
+}
+
+static struct map_entry* map_find(
+	struct map_entry* entries,
+	int alloc,
+	const char* key,
+	uint64_t hash
+) {
+	for (int i = hash & (alloc - 1);; i = (i + 1) & (alloc - 1)) {
+		if (entries[i].key == NULL) return &entries[i];
+		if (entries[i].hash == hash && strcmp(entries[i].key, key) == 0)
+			return &entries[i];
+	}
+}
+
+void* map_get(struct map* this, const char* key) {
+	struct map_entry* entry =
+		map_find(this->entries, this->alloc, key, hash_string(key));
+
+	return entry->key ? entry->value : NULL;
+}
+
+void* map_set(struct map* this, const char* key, void* value) {
+	if ((this->length + 1) * 4 > this->alloc * 3) {
+		int alloc = this->alloc * 2;
+		struct map_entry* entries = calloc(alloc, sizeof(struct map_entry));
+
+		for (int i = 0; i < this->alloc; i++) {
+			if (this->entries[i].key == NULL) continue;
+
+			*map_find(entries, alloc, this->entries[i].key, this->entries[i].hash) =
+				this->entries[i];
+		}
+
+		free(this->entries);
+		this->entries = entries;
+		this->alloc = alloc;
+	}
+
+	uint64_t hash = hash_string(key);
+	struct map_entry* entry = map_find(this->entries, this->alloc, key, hash);
+
+	if (entry->key) {
+		void* old = entry->value;
+		entry->value = value;
+		return old;
+	}
+
+	*entry = (struct map_entry) { astrndup(key, strlen(key)), hash, value };
+	this->length++;
+
+	return NULL;
+}
+
+void* map_iter(
+	struct map* this,
+	void* (* each)(const char*, void*, void*),
+	void* user
+) {
+	for (int i = 0; i < this->alloc; i++) {
+		if (this->entries[i].key == NULL) continue;
+
+		void* ret = each(this->entries[i].key, this->entries[i].value, user);
+		if (ret) return ret;
+	}
+
+	return NULL;
+}
+
+// 64-bit FNV-1a; not cryptographic, only used to detect changed content
+uint64_t hash_bytes(const void* data, size_t length, uint64_t seed) {
+	const unsigned char* bytes = data;
+	uint64_t hash = seed ? seed : 0xcbf29ce484222325;
+
+	for (size_t i = 0; i < length; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3;
+	}
+
+	return hash;
+}
+
+uint64_t hash_string(const char* string) {
+	return hash_bytes(string, strlen(string), 0);
+}
+
+#ifndef NAME
+#define NAME "nasal-docgen"
+#endif
+
+static const char* program_name = NAME;
+
+static _Thread_local void (* error_handler)(const char*, void*);
+static _Thread_local void* error_user;
 
 static char* vasprintf(const char* format, va_list list1) {
 	va_list list2;
@@ -162,30 +295,51 @@ char* asprintf(const char* format, ...) {
 	return vasprintf(format, list1);
 }
 
+void set_program_name(const char* name) {
+	program_name = name;
+}
+
+// errors raised on this thread are passed to handler instead of being printed,
+// without the program name or the trailing newline
+void set_error_handler(void (* handler)(const char*, void*), void* user) {
+	error_handler = handler;
+	error_user = user;
+}
+
+static void report_error(char* message) {
+	if (error_handler) {
+		size_t length = strlen(message);
+		if (length > 0 && message[length - 1] == '\n') message[length - 1] = 0;
+
+		error_handler(message, error_user);
+	} else {
+		fprintf(stderr, "%s: %s", program_name, message);
+	}
+
+	free(message);
+}
+
 void errorf(const char* format, ...) {
 	va_list list1;
 	va_start(list1, format);
 
-	char* message = vasprintf(format, list1);
-	fprintf(stderr, "%s: %s", argv[0], message);
-
-	free(message);
+	report_error(vasprintf(format, list1));
 }
 
 void perrorf(const char* format, ...) {
+	int error = errno;
+
 	va_list list1;
 	va_start(list1, format);
 
 	char* message = vasprintf(format, list1);
-	int length = strlen(argv[0]) + strlen(message) + 3;
-
-	char* buffer = malloc(length);
-	snprintf(buffer, length, "%s: %s", argv[0], message);
 
-	perror(buffer);
+	char description[256];
+	if (strerror_r(error, description, sizeof(description)) != 0)
+		snprintf(description, sizeof(description), "error %d", error);
 
+	report_error(asprintf("%s: %s\n", message, description));
 	free(message);
-	free(buffer);
 }
 
 char* astrndup(const char* src, size_t length) {
@@ -224,3 +378,33 @@ char* read_file(const char* filename) {
 
 	return buffer;
 }
+
+// opens a file in dir_fd for writing, truncating it unless it must be new
+int create_at(int dir_fd, const char* path, bool exclusive) {
+	int flags = O_CREAT | O_WRONLY | (exclusive ? O_EXCL : O_TRUNC);
+	return openat(dir_fd, path, flags, FILE_FLAGS);
+}
+
+// writes all of data to the file at path in dir_fd, replacing its contents
+int write_at(int dir_fd, const char* path, const void* data, size_t length) {
+	int fd = create_at(dir_fd, path, false);
+	if (fd == -1) {
+		perrorf("failed to open '%s'", path);
+		return 2;
+	}
+
+	ssize_t write_result;
+	for (size_t i = 0; i < length; i += write_result) {
+		write_result = write(fd, (const char*) data + i, length - i);
+
+		if (write_result < 0) {
+			perrorf("failed to write '%s'", path);
+			close(fd);
+			return 2;
+		}
+	}
+
+	close(fd);
+
+	return 0;
+}
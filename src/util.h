@@ -3,6 +3,10 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#define FILE_FLAGS (S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH)
 
 #define LIST_ITER_T(list, item, type) \
 	for ( \
@@ -28,12 +32,32 @@ void* list_iter_start(struct list* this);
 bool list_iter_continue(struct list* this);
 void* list_iter_next(struct list* this);
 
+struct map;
+
+struct map* map_new();
+void map_free(struct map* this, void (* each)(void*));
+int map_length(struct map* this);
+void* map_get(struct map* this, const char* key);
+void* map_set(struct map* this, const char* key, void* value);
+void* map_iter(
+	struct map* this,
+	void* (* each)(const char*, void*, void*),
+	void* user
+);
+
+uint64_t hash_bytes(const void* data, size_t length, uint64_t seed);
+uint64_t hash_string(const char* string);
+
 char* asprintf(const char* format, ...);
+void set_program_name(const char* name);
+void set_error_handler(void (* handler)(const char*, void*), void* user);
 void errorf(const char* format, ...);
 void perrorf(const char* format, ...);
 
 char* astrndup(const char* src, size_t length);
 
 char* read_file(const char* filename);
+int create_at(int dir_fd, const char* path, bool exclusive);
+int write_at(int dir_fd, const char* path, const void* data, size_t length);
 
 #endif // ifndef UTIL_H
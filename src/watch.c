@@ -0,0 +1,141 @@
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "util.h"
+#include "watch.h"
+
+#define WATCH_MASK (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE)
+#define SETTLE_MS  15
+
+struct watch {
+	int wd;
+	char* name; /* NULL to match anything in the directory */
+	int id;
+};
+
+struct watcher {
+	int fd;
+	struct list* watches; /* watch */
+};
+
+struct watcher* watcher_new() {
+	int fd = inotify_init1(IN_CLOEXEC);
+	if (fd == -1) {
+		perrorf("failed to initialise inotify");
+		return NULL;
+	}
+
+	struct watcher* this = malloc(sizeof(struct watcher));
+	this->fd = fd;
+	this->watches = list_new();
+
+	return this;
+}
+
+static void watch_free(struct watch* watch) {
+	free(watch->name);
+	free(watch);
+}
+
+void watcher_free(struct watcher* this) {
+	if (this == NULL) return;
+
+	close(this->fd);
+	list_free(this->watches, (void (*)(void*)) watch_free);
+	free(this);
+}
+
+static int add_watch(
+	struct watcher* this,
+	const char* dir,
+	char* name,
+	int id
+) {
+	// editors commonly save by renaming over the original, which would drop a
+	// watch placed on the file itself, so the containing directory is watched
+	int wd = inotify_add_watch(this->fd, dir, WATCH_MASK);
+	if (wd == -1) {
+		perrorf("failed to watch '%s'", dir);
+		free(name);
+		return -1;
+	}
+
+	struct watch* watch = malloc(sizeof(struct watch));
+	*watch = (struct watch) { wd, name, id };
+	list_push(this->watches, watch);
+
+	return 0;
+}
+
+int watcher_add_file(struct watcher* this, const char* path, int id) {
+	char* resolved = realpath(path, NULL);
+	if (resolved == NULL) {
+		perrorf("failed to resolve '%s'", path);
+		return -1;
+	}
+
+	char* slash = strrchr(resolved, '/');
+	char* name = astrndup(slash + 1, strlen(slash + 1));
+	*slash = 0;
+
+	int ret = add_watch(this, slash == resolved ? "/" : resolved, name, id);
+	free(resolved);
+
+	return ret;
+}
+
+int watcher_add_dir(struct watcher* this, const char* path, int id) {
+	return add_watch(this, path, NULL, id);
+}
+
+static int read_events(struct watcher* this, int ids[], int n, int max) {
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+	ssize_t length = read(this->fd, buf, sizeof(buf));
+	if (length == -1) {
+		if (errno == EINTR) return n;
+
+		perrorf("failed to read inotify events");
+		return -1;
+	}
+
+	for (char* ptr = buf; ptr < buf + length;) {
+		struct inotify_event* event = (struct inotify_event*) ptr;
+		ptr += sizeof(struct inotify_event) + event->len;
+
+		LIST_ITER_T(this->watches, watch, struct watch*) {
+			if (watch->wd != event->wd) continue;
+			if (watch->name && (!event->len || strcmp(watch->name, event->name)))
+				continue;
+
+			bool seen = false;
+			for (int i = 0; i < n; i++) if (ids[i] == watch->id) seen = true;
+
+			if (!seen && n < max) ids[n++] = watch->id;
+		}
+	}
+
+	return n;
+}
+
+int watcher_wait(struct watcher* this, int ids[], int max) {
+	int n = 0;
+
+	while (n == 0) {
+		if ((n = read_events(this, ids, 0, max)) == -1) return -1;
+	}
+
+	// saving a file tends to produce a burst of events, so wait for it to settle
+	struct pollfd pfd = { .fd = this->fd, .events = POLLIN };
+	while (poll(&pfd, 1, SETTLE_MS) > 0) {
+		if ((n = read_events(this, ids, n, max)) == -1) return -1;
+	}
+
+	return n;
+}
@@ -0,0 +1,13 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+struct watcher;
+
+struct watcher* watcher_new();
+void watcher_free(struct watcher* this);
+
+int watcher_add_file(struct watcher* this, const char* path, int id);
+int watcher_add_dir(struct watcher* this, const char* path, int id);
+int watcher_wait(struct watcher* this, int ids[], int max);
+
+#endif // ifndef WATCH_H
@@ -0,0 +1,134 @@
+// renders the pages of the spa output from the data of each module and class,
+// which is fetched when it is first shown; the location hash is the dotted path
+// of the page, then a slash and the id of a section in it if there is one
+
+(() => {
+	const app = document.getElementById("app");
+	if (!app) return;
+
+	const root = app.dataset.root;
+	const library = app.dataset.library;
+	const pages = new Map();
+
+	const fetchPage = path => {
+		if (!pages.has(path)) {
+			const name = path ? "root." + path : "root";
+			pages.set(path, fetch(`${root}data/${name}.json`)
+				.then(response => response.ok ? response.json() : null));
+		}
+
+		return pages.get(path);
+	};
+
+	const element = (tag, props = {}, ...children) => {
+		const node = Object.assign(document.createElement(tag), props);
+		node.append(...children);
+		return node;
+	};
+
+	const link = (href, text) => element("a", { href }, text);
+	const join = (path, name) => path ? path + "." + name : name;
+
+	const source = source => source && element("p", {},
+		link(`${root}src/${source.file}.html#${source.line}`, "View source")
+	);
+
+	const description = (desc, raw) => {
+		const node = element("div");
+		if (raw.trim()) node.innerHTML = desc;
+		else node.textContent = "(no description)";
+
+		return node;
+	};
+
+	const member = (path, kind, item) => {
+		const id = `${kind}.${item.name}`;
+		const node = element("div", { className: "flex member", id },
+			element("h3", {}, link(`#${path}/${id}`, item.name)),
+		);
+
+		if (item.source) node.append(source(item.source));
+		node.append(description(item.body, item.rawDesc));
+
+		for (const param of item.params || []) {
+			const chip = param.variable ? "variable"
+				: param.optional ? "optional" : null;
+
+			node.append(element("p", {},
+				element("code", {}, param.name), " ",
+				...(chip ? [element("span", { className: "chip" }, chip)] : [])
+			));
+		}
+
+		return node;
+	};
+
+	const show = async () => {
+		const [path, section] = decodeURIComponent(location.hash.slice(1))
+			.split("/");
+		const page = await fetchPage(path);
+		if (path != decodeURIComponent(location.hash.slice(1)).split("/")[0])
+			return;
+
+		const sections = document.getElementById("sections");
+		sections.replaceChildren();
+
+		if (!page) {
+			app.replaceChildren(element("h1", {}, element("span", {}, "Not found")));
+			return;
+		}
+
+		const kind = page.type == "class" ? "Class"
+			: page.name ? "Namespace" : "Library";
+		document.title = `${kind} ${library}${path ? "." + path : ""}`;
+		document.getElementById("sections-title").textContent = kind;
+
+		const heading = element("h1", {}, element("span", {}, kind));
+		const names = path ? path.split(".") : [];
+		heading.append(link("#", library));
+		names.forEach((name, i) => heading.append(
+			" . ", link("#" + names.slice(0, i + 1).join("."), name)
+		));
+
+		const nodes = [heading];
+		if (page.source) nodes.push(source(page.source));
+
+		const desc = description(page.desc, page.rawDesc);
+		desc.id = "description";
+		nodes.push(desc);
+
+		const lists = [
+			["modules", "Sub-namespaces"],
+			["classes", "Classes"],
+			["funcs", "Functions"],
+			["vars", "Variables"],
+		];
+
+		for (const [key, title] of lists) {
+			if (!page[key] || !page[key].length) continue;
+
+			nodes.push(element("h2", { id: key }, title));
+			sections.append(element("li", {}, link(`#${path}/${key}`, title)));
+
+			for (const item of page[key]) {
+				if (key == "modules" || key == "classes") {
+					nodes.push(element("div", { className: "flex" },
+						element("h3", {}, link("#" + join(path, item.name), item.name)),
+						...(item.desc ? [element("p", {}, item.desc)] : [])
+					));
+				} else {
+					nodes.push(member(path, key.slice(0, -1), item));
+				}
+			}
+		}
+
+		app.replaceChildren(...nodes);
+
+		const target = section && document.getElementById(section);
+		if (target) target.scrollIntoView();
+		else window.scrollTo(0, 0);
+	};
+
+	window.addEventListener("hashchange", show);
+	show();
+})();
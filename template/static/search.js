@@ -0,0 +1,127 @@
+// searches search.json by name prefix, and the full-text index when there is
+// one; the indexes are only fetched when first needed
+
+(() => {
+	const input = document.getElementById("search");
+	const results = document.getElementById("results");
+	if (!input || !results) return;
+
+	const root = input.dataset.root;
+	let index = null;
+
+	const load = () => index || (index = fetch(root + "search.json")
+		.then(response => response.json())
+		.then(json => {
+			const names = [], lower = [];
+			let last = "";
+
+			for (const [shared, rest] of json.entries) {
+				last = last.slice(0, shared) + rest;
+				names.push(last);
+				lower.push(last.toLowerCase());
+			}
+
+			return { ...json, names, lower };
+		}));
+
+	const url = (index, i) => {
+		const [, , kind, parent] = index.entries[i];
+		const path = index.parents[parent];
+		const dir = path ? path.split(".").join("/") + "/" : "";
+		const name = index.names[i];
+		const page = kind == "f" ? "func." : "var.";
+
+		if (index.spa) {
+			return kind == "m" || kind == "c"
+				? `${root}index.html#${path ? path + "." : ""}${name}`
+				: `${root}index.html#${path}/${page}${name}`;
+		}
+
+		if (kind == "m" || kind == "c") return `${root}${dir}${name}/index.html`;
+
+		return index.aggregate
+			? `${root}${dir}index.html#${page}${name}`
+			: `${root}${dir}${page}${name}.html`;
+	};
+
+	const shards = new Map();
+
+	const shard = n => {
+		if (!shards.has(n)) {
+			const name = String(n).padStart(2, "0");
+			shards.set(n, fetch(`${root}fulltext/${name}.json`)
+				.then(response => response.ok ? response.json() : {}));
+		}
+
+		return shards.get(n);
+	};
+
+	// the documents with every trigram of the words of query, as in fulltext.c
+	const fullText = async (index, query) => {
+		const trigrams = new Set();
+		for (const word of query.split(/[^0-9a-z]+/))
+			for (let i = 0; i + 3 <= word.length; i++)
+				trigrams.add(word.slice(i, i + 3));
+
+		if (!trigrams.size) return [];
+
+		let docs = null;
+		for (const trigram of trigrams) {
+			const code = [...trigram].reduce((c, x) => c * 36 + parseInt(x, 36), 0);
+			const deltas = (await shard(code % index.fullText))[trigram] || [];
+
+			let doc = 0;
+			const found = new Set(deltas.map(delta => doc += delta));
+			docs = docs ? docs.filter(doc => found.has(doc)) : [...found];
+		}
+
+		return docs;
+	};
+
+	const show = (found, i) => {
+		const path = found.parents[found.entries[i][3]];
+		const link = document.createElement("a");
+		link.href = url(found, i);
+		link.textContent = (path ? path + "." : "") + found.names[i];
+
+		const item = document.createElement("li");
+		item.append(link);
+		results.append(item);
+	};
+
+	const search = async () => {
+		const query = input.value.trim().toLowerCase();
+		const found = await load();
+
+		if (query != input.value.trim().toLowerCase()) return;
+		results.replaceChildren();
+		if (!query) return;
+
+		// the first name with the query as a prefix, by binary search
+		let low = 0, high = found.lower.length;
+		while (low < high) {
+			const mid = (low + high) >> 1;
+			if (found.lower[mid] < query) low = mid + 1;
+			else high = mid;
+		}
+
+		const shown = new Set();
+		for (let i = low; i < found.lower.length && i < low + 50; i++) {
+			if (!found.lower[i].startsWith(query)) break;
+
+			show(found, i);
+			shown.add(i);
+		}
+
+		if (!found.fullText) return;
+
+		const docs = await fullText(found, query);
+		if (query != input.value.trim().toLowerCase()) return;
+
+		for (const doc of docs.filter(doc => !shown.has(doc)).slice(0, 50))
+			show(found, doc);
+	};
+
+	input.addEventListener("focus", load, { once: true });
+	input.addEventListener("input", search);
+})();
@@ -0,0 +1,40 @@
+// fills in the source tree of a source page from src/tree.json, which is
+// written once rather than into every page
+
+(() => {
+	const tree = document.getElementById("tree");
+	if (!tree || !tree.dataset.src) return;
+
+	fetch(tree.dataset.src + "tree.json")
+		.then(response => response.json())
+		.then(items => {
+			for (const item of items) {
+				if (item == "") continue;
+
+				const dir = item.endsWith("/");
+				const parents = item.split("/");
+				if (dir) parents.pop();
+				const name = parents.pop();
+
+				const entry = document.createElement("li");
+				entry.style.setProperty("--indent", parents.length);
+
+				const target = dir ? entry : document.createElement("a");
+				if (parents.length) {
+					const hidden = document.createElement("span");
+					hidden.className = "hidden";
+					hidden.textContent = parents.join("/") + "/";
+					target.append(hidden);
+				}
+
+				target.append(dir ? name + "/" : name);
+
+				if (!dir) {
+					target.href = tree.dataset.src + item + ".html";
+					entry.append(target);
+				}
+
+				tree.append(entry);
+			}
+		});
+})();
@@ -0,0 +1,107 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "docgen.h"
+
+/*
+	runs two contexts of the library at once, one of which fails, and checks
+	that each error reaches the callback of its own context rather than stderr;
+	run from the root of the repository, as test/run.sh is
+*/
+
+struct run {
+	const char* inputs[3];
+	int status;
+	int n_files;
+	int n_errors;
+	char error[256];
+};
+
+static void on_error(const char* message, void* user) {
+	struct run* run = user;
+
+	run->n_errors++;
+	snprintf(run->error, sizeof(run->error), "%s", message);
+}
+
+static int on_write(
+	const char* path,
+	const char* data,
+	size_t length,
+	void* user
+) {
+	((struct run*) user)->n_files++;
+	return 0;
+}
+
+static void* generate(void* user) {
+	struct run* run = user;
+	struct docgen_options opts = {
+		.library = "test",
+		.template = "template",
+		.error = on_error,
+		.error_user = run,
+	};
+
+	struct docgen* ctx = docgen_new(&opts, &run->status);
+	if (ctx == NULL) return NULL;
+
+	for (const char** input = run->inputs; *input && run->status == 0; input++)
+		run->status = docgen_add_input(ctx, *input, NULL);
+
+	if (run->status == 0) run->status = docgen_parse(ctx);
+	if (run->status == 0) run->status = docgen_generate_to(ctx, on_write, run);
+
+	docgen_free(ctx);
+	return NULL;
+}
+
+int main() {
+	// anything printed to stderr is a message which missed its callback
+	FILE* err = tmpfile();
+	if (err == NULL || dup2(fileno(err), STDERR_FILENO) == -1) {
+		puts("FAIL: could not capture stderr");
+		return 1;
+	}
+
+	struct run good = { .inputs = { "test/all.nas", "test/type.nas" } };
+	struct run bad = { .inputs = { "test/missing.nas" } };
+
+	pthread_t threads[2];
+	pthread_create(&threads[0], NULL, generate, &good);
+	pthread_create(&threads[1], NULL, generate, &bad);
+	pthread_join(threads[0], NULL);
+	pthread_join(threads[1], NULL);
+
+	int failed = 0;
+
+	if (good.status != 0 || good.n_files == 0) {
+		printf("FAIL: generating failed with status %d\n", good.status);
+		failed = 1;
+	}
+
+	if (good.n_errors != 0) {
+		printf("FAIL: another context's error was reported: %s\n", good.error);
+		failed = 1;
+	}
+
+	if (bad.status == 0 || bad.n_errors == 0) {
+		puts("FAIL: a missing input was not reported to its callback");
+		failed = 1;
+	} else if (!strstr(bad.error, "test/missing.nas")) {
+		printf("FAIL: the error does not name the input: %s\n", bad.error);
+		failed = 1;
+	}
+
+	struct stat st;
+	if (fstat(STDERR_FILENO, &st) == -1 || st.st_size != 0) {
+		puts("FAIL: errors were printed to stderr");
+		failed = 1;
+	}
+
+	if (failed == 0) puts("library tests passed");
+	return failed;
+}
@@ -0,0 +1,393 @@
+#!/bin/sh
+# runs the behaviour checks against a built nasal-docgen, given as the first
+# argument (default ./nasal-docgen), from the root of the repository
+
+bin=${1:-./nasal-docgen}
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+failed=0
+
+fail() {
+	echo "FAIL: $*" >&2
+	failed=1
+}
+
+# the date in the pages is fixed, so that runs can be compared
+SOURCE_DATE_EPOCH=0
+export SOURCE_DATE_EPOCH
+
+generate() {
+	out=$1
+	shift
+	"$bin" -t=template -r=test -o="$out" "$@" test/all.nas test/type.nas
+}
+
+# reproducibility: the same inputs give the same bytes
+generate "$tmp/a" 2>/dev/null || fail "generating docs"
+generate "$tmp/b" 2>/dev/null || fail "generating docs again"
+diff -r "$tmp/a" "$tmp/b" >&2 || fail "two runs gave different output"
+
+# check mode (--check): clean sources pass, and each problem is reported with
+# its code, where it is and how severe it is
+"$bin" --check test/all.nas test/type.nas >"$tmp/clean" 2>/dev/null ||
+	fail "--check reported errors in test/all.nas or test/type.nas"
+
+"$bin" --check test/check/bad.nas >"$tmp/bad" 2>/dev/null
+[ $? -eq 3 ] || fail "--check did not fail with status 3 on test/check/bad.nas"
+
+for code in unknown-param unknown-marker bad-type; do
+	grep -q "\"code\":\"$code\"" "$tmp/bad" ||
+		fail "--check did not report $code"
+done
+
+place='"file":"test/check/bad.nas","line":[0-9]+,"severity":"(error|warning)"'
+grep -Ev "$place" "$tmp/bad" | grep -q . &&
+	fail "--check reported a problem without its place"
+
+# hashed statics: the pages and the stylesheet use the hashed names
+generate "$tmp/hashed" --hash-statics 2>/dev/null ||
+	fail "generating docs with --hash-statics"
+[ ! -e "$tmp/hashed/style.css" ] || fail "--hash-statics wrote style.css"
+
+css=$(cd "$tmp/hashed" && ls style.*.css 2>/dev/null)
+if [ -z "$css" ]; then
+	fail "--hash-statics wrote no hashed stylesheet"
+else
+	grep -q "$css" "$tmp/hashed/index.html" || fail "index.html does not use $css"
+	grep -q 'url(roboto-400\.[0-9a-f]*\.woff2)' "$tmp/hashed/$css" ||
+		fail "$css does not use the hashed font names"
+fi
+
+# manifest: an unchanged run lists nothing, and a run without a file removes
+# its pages and lists them
+generate "$tmp/m" --manifest >/dev/null 2>&1 ||
+	fail "generating docs with --manifest"
+generate "$tmp/m" --manifest >"$tmp/same" 2>/dev/null ||
+	fail "generating docs with --manifest again"
+[ ! -s "$tmp/same" ] || fail "--manifest listed changes to an unchanged run"
+
+"$bin" -t=template -r=test -o="$tmp/m" --manifest test/type.nas \
+	>"$tmp/pruned" 2>/dev/null || fail "generating docs without test/all.nas"
+grep -q '^D ' "$tmp/pruned" || fail "--manifest removed nothing"
+
+for path in $(sed -n 's/^D //p' "$tmp/pruned"); do
+	[ ! -e "$tmp/m/$path" ] || fail "--manifest did not remove $path"
+done
+
+for path in $(cut -d ' ' -f 3- "$tmp/m/.manifest"); do
+	[ -e "$tmp/m/$path" ] || fail "$path is in the manifest but not the output"
+done
+
+# objects: a file compiled with a module links like the file itself, under
+# that module and with its source page
+"$bin" -c -o="$tmp/type.ndo" test/type.nas:mod.path 2>/dev/null ||
+	fail "compiling test/type.nas:mod.path"
+"$bin" -t=template -r=test -o="$tmp/linked" test/all.nas "$tmp/type.ndo" \
+	2>/dev/null || fail "generating docs from an object"
+[ -f "$tmp/linked/mod/path/index.html" ] ||
+	fail "the object was not documented as mod.path"
+[ -f "$tmp/linked/src/type.nas.html" ] ||
+	fail "the object has no source page"
+
+# entry: only the files reached from the entry are documented, a named load is
+# its own module, and an included file does not replace the module description
+"$bin" -t=template -r=test -o="$tmp/entry" --entry=test/entry/main.nas \
+	2>/dev/null || fail "generating docs with --entry"
+[ -f "$tmp/entry/lib/index.html" ] || fail "--entry did not document lib"
+[ -f "$tmp/entry/src/lib.nas.html" ] || fail "--entry gave lib no source page"
+[ ! -e "$tmp/entry/unused" ] || fail "--entry documented an unreached file"
+grep -q 'Entry module' "$tmp/entry/main/index.html" 2>/dev/null ||
+	fail "--entry lost the description of main"
+[ -f "$tmp/entry/main/var.part.html" ] ||
+	fail "--entry did not include part.nas into main"
+
+# low memory: documenting one module at a time gives the same pages, and what
+# needs the whole library is refused
+generate "$tmp/low" --low-memory 2>/dev/null ||
+	fail "generating docs with --low-memory"
+diff -r "$tmp/a" "$tmp/low" >&2 || fail "--low-memory gave different output"
+
+for option in --spa --only=all; do
+	generate "$tmp/refused" --low-memory $option 2>/dev/null
+	[ $? -eq 1 ] || fail "--low-memory did not refuse $option"
+done
+
+# symbols: a table written by one run resolves the classes named by another,
+# which is only done when checking
+generate "$tmp/syms" --symbols="$tmp/test.nds" 2>/dev/null ||
+	fail "generating docs with --symbols"
+"$bin" --check --link-with="$tmp/test.nds" test/check/linked.nas \
+	>"$tmp/linked" 2>/dev/null || fail "--check --link-with failed"
+grep -q "'nowhere.Class'" "$tmp/linked" ||
+	fail "--link-with did not report nowhere.Class"
+! grep -q "'all.myClass'" "$tmp/linked" ||
+	fail "--link-with did not resolve all.myClass from the table"
+
+"$bin" --link-with="$tmp/test.nds" -o="$tmp/unlinked" test/check/linked.nas \
+	2>/dev/null
+[ $? -eq 1 ] || fail "--link-with was accepted without --check"
+
+# batch: each library is documented as a run of its own would, and what only
+# fits a single library is refused
+cat >"$tmp/batch.json" <<EOF
+[
+	{
+		"name": "test",
+		"output": "$tmp/batch/test",
+		"inputs": [ "test/all.nas", "test/type.nas" ]
+	},
+	{
+		"name": "entry",
+		"output": "$tmp/batch/entry",
+		"inputs": [ "test/entry/" ]
+	}
+]
+EOF
+"$bin" -t=template --batch="$tmp/batch.json" 2>/dev/null ||
+	fail "generating docs with --batch"
+diff -r "$tmp/a" "$tmp/batch/test" >&2 ||
+	fail "--batch gave different output from a single run"
+[ -f "$tmp/batch/entry/index.html" ] || fail "--batch skipped a library"
+
+"$bin" -t=template --batch="$tmp/batch.json" --manifest >/dev/null 2>&1
+[ $? -eq 1 ] || fail "--batch did not refuse --manifest"
+
+# serve: pages are rendered on request as they would be written, and a dir is
+# served as html
+if command -v curl >/dev/null; then
+	port=$((20000 + $$ % 10000))
+	"$bin" -t=template -r=test --serve=127.0.0.1:$port \
+		test/all.nas test/type.nas 2>/dev/null &
+	server=$!
+
+	tries=0
+	until curl -s -o /dev/null "http://127.0.0.1:$port/" || [ $tries -eq 50 ]; do
+		sleep 0.1
+		tries=$((tries + 1))
+	done
+
+	curl -s -D "$tmp/headers" -o "$tmp/served" "http://127.0.0.1:$port/all/" ||
+		fail "--serve did not respond"
+	grep -qi '^content-type: text/html' "$tmp/headers" ||
+		fail "--serve did not serve all/ as html"
+	cmp -s "$tmp/served" "$tmp/a/all/index.html" ||
+		fail "--serve gave a different all/index.html"
+
+	kill $server 2>/dev/null
+	wait $server 2>/dev/null
+else
+	echo "skipping --serve, as curl was not found" >&2
+fi
+
+# watch: a change to an input is picked up without starting again
+mkdir -p "$tmp/watched"
+cp test/all.nas "$tmp/watched/all.nas"
+"$bin" -t=template -r=test -o="$tmp/watch" -w "$tmp/watched/all.nas" \
+	2>/dev/null &
+watcher=$!
+
+tries=0
+until [ -f "$tmp/watch/all/index.html" ] || [ $tries -eq 50 ]; do
+	sleep 0.1
+	tries=$((tries + 1))
+done
+
+# the watches are added once the first run has finished writing
+sleep 0.5
+printf '\n## A function added while watching.\nvar addedLater = func {};\n' \
+	>>"$tmp/watched/all.nas"
+
+tries=0
+until [ -f "$tmp/watch/all/func.addedLater.html" ] || [ $tries -eq 50 ]; do
+	sleep 0.1
+	tries=$((tries + 1))
+done
+
+[ -f "$tmp/watch/all/func.addedLater.html" ] ||
+	fail "--watch did not document a function added to its input"
+
+kill $watcher 2>/dev/null
+wait $watcher 2>/dev/null
+
+# only: the selected subtree is written as in a full run, and nothing else
+generate "$tmp/only" --only=all.myClass 2>/dev/null ||
+	fail "generating docs with --only"
+cmp -s "$tmp/a/all/myClass/index.html" "$tmp/only/all/myClass/index.html" ||
+	fail "--only gave a different all/myClass/index.html"
+for path in all/index.html list.html src.html type; do
+	[ ! -e "$tmp/only/$path" ] || fail "--only=all.myClass wrote $path"
+done
+
+generate "$tmp/only-list" --only=all.myClass --with-list 2>/dev/null ||
+	fail "generating docs with --only and --with-list"
+cmp -s "$tmp/a/list.html" "$tmp/only-list/list.html" ||
+	fail "--with-list gave a different list.html"
+
+generate "$tmp/only-none" --only=nowhere 2>/dev/null
+[ $? -eq 3 ] || fail "--only did not fail on a path which does not exist"
+
+# depfile: each page has a rule listing the sources and template pages it was
+# generated from
+generate "$tmp/md" -MD="$tmp/md.d" 2>/dev/null ||
+	fail "generating docs with -MD"
+grep -q "^$tmp/md/all/myClass/index.html:" "$tmp/md.d" ||
+	fail "-MD has no rule for all/myClass/index.html"
+sed -n "\\|^$tmp/md/all/myClass/index.html:|,/[^\\\\]\$/p" "$tmp/md.d" \
+	>"$tmp/md.rule"
+grep -q 'test/all\.nas' "$tmp/md.rule" ||
+	fail "-MD does not make all/myClass/index.html depend on test/all.nas"
+grep -q 'template/pages/item\.html' "$tmp/md.rule" ||
+	fail "-MD does not make all/myClass/index.html depend on its template"
+! grep -q 'test/type\.nas' "$tmp/md.rule" ||
+	fail "-MD makes all/myClass/index.html depend on test/type.nas"
+
+# formats: every format is written from one run, and the pages are unchanged
+generate "$tmp/formats" -f=html,json,markdown,man 2>/dev/null ||
+	fail "generating docs in every format"
+for path in api.json api.md man/test.3 man/test.all.3; do
+	[ -s "$tmp/formats/$path" ] || fail "-f did not write $path"
+done
+cmp -s "$tmp/a/all/index.html" "$tmp/formats/all/index.html" ||
+	fail "-f gave a different all/index.html"
+grep -q '^# test' "$tmp/formats/api.md" || fail "api.md has no title"
+grep -q '^\.TH "test\.all" 3' "$tmp/formats/man/test.all.3" ||
+	fail "man/test.all.3 has no title"
+
+generate "$tmp/json" -f=json 2>/dev/null || fail "generating docs as json"
+[ ! -e "$tmp/json/index.html" ] || fail "-f=json also wrote the pages"
+
+# model: the streamed model matches the json format, and has a line for each
+# module and item with --ndjson
+generate "$tmp/model" --emit-model="$tmp/model.json" 2>/dev/null ||
+	fail "generating docs with --emit-model"
+cmp -s "$tmp/model.json" "$tmp/json/api.json" ||
+	fail "--emit-model differs from -f=json"
+grep -q '"name":"myClass","path":"all.myClass"' "$tmp/model.json" ||
+	fail "--emit-model has no all.myClass"
+
+generate "$tmp/model" --emit-model="$tmp/model.ndjson" --ndjson 2>/dev/null ||
+	fail "generating docs with --emit-model --ndjson"
+grep -v '^{.*}$' "$tmp/model.ndjson" | grep -q . &&
+	fail "--ndjson wrote a line which is not an object"
+grep -q '"path":"all.myClass",.*"parent":"all"' "$tmp/model.ndjson" ||
+	fail "--ndjson has no line for all.myClass under all"
+
+# aggregate: variables and functions are sections of their parent's page, and
+# the list links to those sections
+generate "$tmp/aggregate" --aggregate 2>/dev/null ||
+	fail "generating docs with --aggregate"
+members=$(find "$tmp/aggregate" -name 'func.*.html' -o -name 'var.*.html')
+[ -z "$members" ] || fail "--aggregate wrote pages for members: $members"
+grep -q 'id="func.myMethod"' "$tmp/aggregate/all/myClass/index.html" ||
+	fail "--aggregate has no section for all.myClass.myMethod"
+grep -q 'index.html#func.myMethod' "$tmp/aggregate/list.html" ||
+	fail "--aggregate list does not link to the section of myMethod"
+
+# shard list: each top-level namespace has a list page of its own, which the
+# index links to
+generate "$tmp/shard" --shard-list 2>/dev/null ||
+	fail "generating docs with --shard-list"
+for shard in all type; do
+	[ -f "$tmp/shard/list.$shard.html" ] ||
+		fail "--shard-list did not write list.$shard.html"
+	grep -q "href=\"list.$shard.html\"" "$tmp/shard/list.html" ||
+		fail "--shard-list index does not link to list.$shard.html"
+done
+grep -q 'myMethod' "$tmp/shard/list.all.html" ||
+	fail "list.all.html does not list all.myClass.myMethod"
+! grep -q 'myMethod' "$tmp/shard/list.type.html" ||
+	fail "list.type.html lists a member of all"
+
+# search: the name index lists each item once, under the path of its parent
+[ -s "$tmp/a/search.json" ] || fail "no search.json was written"
+grep -q '"fullText":0,"parents":\[[^]]*"all.myClass"' "$tmp/a/search.json" ||
+	fail "search.json does not have all.myClass as a parent"
+grep -q '"entries":\[\[0,"' "$tmp/a/search.json" ||
+	fail "search.json does not start its entries with a whole name"
+grep -q '"Class","c",' "$tmp/a/search.json" ||
+	fail "search.json does not list all.myClass as a class"
+
+# full text: the trigrams of the descriptions are split over the shards by
+# their code, so "exa" (from "example") is in shard 14
+generate "$tmp/fulltext" --full-text 2>/dev/null ||
+	fail "generating docs with --full-text"
+grep -q '"fullText":64' "$tmp/fulltext/search.json" ||
+	fail "--full-text search.json does not give the number of shards"
+[ -f "$tmp/fulltext/fulltext/63.json" ] ||
+	fail "--full-text wrote too few shards"
+grep -q '"exa":\[' "$tmp/fulltext/fulltext/14.json" ||
+	fail "--full-text did not index \"exa\" in shard 14"
+! grep -q '"exa"' "$tmp/fulltext/fulltext/13.json" ||
+	fail "--full-text indexed \"exa\" in the wrong shard"
+
+# source tree: the tree is written once for the source pages to fetch, and only
+# the index of the sources lists it
+grep -q '"all.nas"' "$tmp/a/src/tree.json" 2>/dev/null &&
+	grep -q '"type.nas"' "$tmp/a/src/tree.json" ||
+	fail "src/tree.json does not list every source"
+grep -q 'href="\.\./src/type\.nas\.html"' "$tmp/a/src/all.nas.html" &&
+	fail "src/all.nas.html holds the whole source tree"
+grep -q 'id="tree" data-src=' "$tmp/a/src/all.nas.html" ||
+	fail "src/all.nas.html does not fetch the source tree"
+grep -q 'src/type\.nas\.html' "$tmp/a/src.html" ||
+	fail "src.html does not list the sources"
+
+# spa: one page, with the data of each namespace and class beside it
+generate "$tmp/spa" --spa 2>/dev/null || fail "generating docs with --spa"
+for path in index.html data/root.json data/root.all.json \
+	data/root.all.myClass.json src.html search.json; do
+	[ -f "$tmp/spa/$path" ] || fail "--spa did not write $path"
+done
+for path in list.html all/index.html; do
+	[ ! -e "$tmp/spa/$path" ] || fail "--spa wrote $path"
+done
+grep -q 'myMethod' "$tmp/spa/data/root.all.myClass.json" ||
+	fail "--spa data of all.myClass does not have myMethod"
+
+# precompress: each file has compressed copies beside it with the same contents
+generate "$tmp/compressed" --precompress 2>/dev/null ||
+	fail "generating docs with --precompress"
+for path in index.html all/myClass/index.html search.json style.css; do
+	gzip -dc "$tmp/compressed/$path.gz" 2>/dev/null |
+		cmp -s - "$tmp/compressed/$path" || fail "$path.gz does not match $path"
+
+	if [ -e "$tmp/compressed/$path.br" ] && command -v brotli >/dev/null; then
+		brotli -dc "$tmp/compressed/$path.br" |
+			cmp -s - "$tmp/compressed/$path" || fail "$path.br does not match $path"
+	fi
+done
+diff -r -x '*.gz' -x '*.br' "$tmp/a" "$tmp/compressed" >&2 ||
+	fail "--precompress changed the uncompressed output"
+
+# minify: the pages lose their comments and indentation, but not the contents
+# of pre elements
+generate "$tmp/minified" --minify 2>/dev/null ||
+	fail "generating docs with --minify"
+! grep -q '<!--' "$tmp/minified/index.html" ||
+	fail "--minify left a comment in index.html"
+[ $(wc -c <"$tmp/minified/index.html") -lt $(wc -c <"$tmp/a/index.html") ] ||
+	fail "--minify did not make index.html smaller"
+tab=$(printf '\t')
+grep -q "^${tab}myConstant: 123,\$" "$tmp/minified/src/all.nas.html" ||
+	fail "--minify changed the source in src/all.nas.html"
+
+# static store: the outputs sharing a store link the same copy of each static
+generate "$tmp/linked1" --static-store="$tmp/store" 2>/dev/null ||
+	fail "generating docs with --static-store"
+generate "$tmp/linked2" --static-store="$tmp/store" 2>/dev/null ||
+	fail "generating docs with --static-store again"
+stored=$(ls "$tmp/store" 2>/dev/null | grep -e '-style\.css$')
+if [ -z "$stored" ]; then
+	fail "--static-store did not add style.css to the store"
+else
+	for out in linked1 linked2; do
+		[ "$tmp/$out/style.css" -ef "$tmp/store/$stored" ] ||
+			fail "$out/style.css is not linked from the store"
+	done
+fi
+cmp -s "$tmp/a/style.css" "$tmp/linked1/style.css" ||
+	fail "--static-store changed style.css"
+
+if [ $failed -eq 0 ]; then echo "all tests passed"; fi
+exit $failed